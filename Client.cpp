@@ -5,190 +5,318 @@
 #include <endian.h>
 #include <unistd.h>
 #include <sys/un.h>
-#include <sys/select.h>
-#include <sys/timerfd.h>
-#include <sys/eventfd.h>
-#include <sys/poll.h>
-#include <time.h>
+#include <sys/epoll.h>
 #include <fcntl.h>
-#include <thread>
 #include <errno.h>
-
-#include <iostream>
-using namespace std;
+#include <cstring>
+#include <memory>
 
 #include "Utils.hpp"
 
-void DowowNetwork::Client::TcpThreadFunc(Client *c, std::string ip, uint16_t port, int timeout) {
-    // connection in progress
-    std::lock_guard<std::mutex> __tsfdm(c->mutex_tsfd);
+bool DowowNetwork::Client::MakeTcpAddress(std::string ip, uint16_t port, sockaddr_storage& addr, socklen_t& length) {
+    sockaddr_in *in = reinterpret_cast<sockaddr_in*>(&addr);
+    memset(in, 0, sizeof(*in));
+    in->sin_family = AF_INET;
+    in->sin_port = htobe16(port);
+    length = sizeof(*in);
 
-    // create the address to connect to
-    sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port = htobe16(port);
     // ip
-    if (!inet_aton(ip.c_str(), &addr.sin_addr)) {
-        // invalid
-        close(c->temp_socket_fd);
-        c->temp_socket_fd = -1;
-        // notify
-        Utils::WriteEventFd(c->connect_event, 1);
-        return;
-    }
+    return inet_aton(ip.c_str(), &in->sin_addr);
+}
 
-    // connect
-    int connect_res = connect(
-        c->temp_socket_fd,
-        (sockaddr*)&addr,
-        sizeof(addr));
-
-    // in progress
-    if (connect_res == -1 && errno == EINPROGRESS) {
-        // wait for result
-        connect_res = !Utils::SelectRead(c->temp_socket_fd, timeout);
+bool DowowNetwork::Client::MakeUnixAddress(std::string socket_path, sockaddr_storage& addr, socklen_t& length) {
+    sockaddr_un *un = reinterpret_cast<sockaddr_un*>(&addr);
+    memset(un, 0, sizeof(*un));
+    un->sun_family = AF_UNIX;
+    length = sizeof(*un);
+
+    // too long
+    if (socket_path.size() >= sizeof(un->sun_path)) return false;
+    memcpy(un->sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return true;
+}
+
+void DowowNetwork::Client::ConnectEventFunc(Watcher *w, uint32_t events) {
+    Client *c = reinterpret_cast<Client*>(w->owner);
+
+    // the result of connect()
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(w->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+    c->FinishConnect(!error);
+}
+
+void DowowNetwork::Client::ConnectTimerFunc(Timer *t) {
+    Client *c = reinterpret_cast<Client*>(t->owner);
+
+    if (c->connect_deadline && Utils::GetMonotonicMS() >= c->connect_deadline) {
+        // timed out
+        c->FinishConnect(false);
+    } else {
+        // retry
+        c->TryConnect();
     }
+}
 
-    // fail
-    if (connect_res) {
-        // fail
-        close(c->temp_socket_fd);
-        c->temp_socket_fd = -1;
-        // notify
-        Utils::WriteEventFd(c->connect_event, 1);
-        return;
+bool DowowNetwork::Client::StartConnect(
+    const sockaddr *addr,
+    socklen_t length,
+    int timeout,
+    ConnectCallback callback)
+{
+    {
+        std::lock_guard<std::mutex> __tsfdm(mutex_tsfd);
+
+        // check if connected or connecting
+        if (is_connecting || IsConnected())
+            return false;
+
+        // the socket is nonblocking until connected
+        int socket_fd = socket(
+            addr->sa_family,
+            SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+            0);
+        // failed to create the temp socket
+        if (socket_fd == -1)
+            return false;
+
+        temp_socket_fd = socket_fd;
+        is_connecting = true;
+        memcpy(&connect_addr, addr, length);
+        connect_addr_length = length;
+        connect_deadline = timeout < 0 ? 0 :
+            Utils::GetMonotonicMS() + static_cast<uint64_t>(timeout) * 1000;
+        connect_callback = callback;
+        connect_loop = PickLoop();
+        connect_attempt++;
+
+        // the loop drives the attempt
+        PostConnectTask(&Client::TryConnect);
     }
 
-    // connected
-    c->InitializeByFD(c->temp_socket_fd);
-    // unset temp socket fd
-    c->temp_socket_fd = -1;
+    return true;
+}
+
+void DowowNetwork::Client::PostConnectTask(void (Client::*task)()) {
+    connect_tasks++;
+    uint32_t attempt = connect_attempt;
+    connect_loop->Post([this, task, attempt]() {
+        mutex_tsfd.lock();
+        bool is_current = temp_socket_fd != -1 && connect_attempt == attempt;
+        mutex_tsfd.unlock();
+
+        if (is_current) (this->*task)();
+
+        // notify under the lock: the client may be destroyed right after
+        std::lock_guard<std::mutex> __tsfdm(mutex_tsfd);
+        connect_tasks--;
+        connect_cv.notify_all();
+    });
+}
+
+void DowowNetwork::Client::AbortConnect() {
+    FinishConnect(false);
+}
+
+void DowowNetwork::Client::TryConnect() {
+    int connect_res = connect(
+        temp_socket_fd,
+        reinterpret_cast<sockaddr*>(&connect_addr),
+        connect_addr_length);
 
-    // setup the request id part
-    c->SetEvenRequestIdsPart(true);
+    // connected at once
+    if (!connect_res) {
+        FinishConnect(true);
+        return;
+    }
 
-    // notify
-    Utils::WriteEventFd(c->connect_event, 1);
+    uint64_t now = Utils::GetMonotonicMS();
+    if (errno == EINPROGRESS) {
+        // wait for the result
+        connect_loop->Add(&connect_watcher, temp_socket_fd, EPOLLOUT);
+        if (connect_deadline)
+            connect_loop->StartTimer(&connect_timer, connect_deadline);
+    } else if (errno == EAGAIN && (!connect_deadline || now < connect_deadline)) {
+        // the UNIX server's backlog is full, try again a bit later
+        uint64_t retry = now + 1;
+        if (connect_deadline && connect_deadline < retry)
+            retry = connect_deadline;
+        connect_loop->StartTimer(&connect_timer, retry);
+    } else {
+        // fail
+        FinishConnect(false);
+    }
 }
 
-void DowowNetwork::Client::UnixThreadFunc(Client *c, std::string socket_path, int timeout) {
-    // connection in progress
-    std::lock_guard<std::mutex> __tsfdm(c->mutex_tsfd);
+void DowowNetwork::Client::FinishConnect(bool is_success) {
+    connect_loop->Remove(&connect_watcher);
+    connect_loop->StopTimer(&connect_timer);
 
-    // create the address to connect to
-    sockaddr_un addr;
-    addr.sun_family = AF_UNIX;
-    memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    if (is_success) {
+        // remark:  the socket stays nonblocking, as the accepted ones are
 
-    // connect
-    int connect_res = connect(c->temp_socket_fd, (sockaddr*)&addr, sizeof(addr));
+        // setup the request id part
+        // remark:  the server uses the even ids
+        SetEvenRequestIdsPart(false);
 
-    // in progress
-    if (connect_res == -1 && errno == EINPROGRESS) {
-        // wait for result
-        connect_res = !Utils::SelectRead(c->temp_socket_fd, timeout);
+        // connected, served by the loop that has connected it
+        InitializeByFD(temp_socket_fd, connect_loop);
+        is_success = IsConnected();
     }
+    if (!is_success) close(temp_socket_fd);
 
-    // fail
-    if (connect_res) {
-        // fail
-        close(c->temp_socket_fd);
-        c->temp_socket_fd = -1;
-        // notify
-        Utils::WriteEventFd(c->connect_event, 1);
-        return;
+    ConnectCallback callback;
+    {
+        std::lock_guard<std::mutex> __tsfdm(mutex_tsfd);
+        temp_socket_fd = -1;
+        callback.swap(connect_callback);
     }
 
-    // connected
-    c->InitializeByFD(c->temp_socket_fd);
-    c->temp_socket_fd = -1;
+    if (callback) callback(this, is_success);
 
-    // request part setup
-    c->SetEvenRequestIdsPart(true);
+    // notify under the lock: the client may be destroyed right after
+    std::lock_guard<std::mutex> __tsfdm(mutex_tsfd);
+    is_connecting = false;
+    connect_loop = 0;
+    connect_cv.notify_all();
+}
 
-    // notify
-    Utils::WriteEventFd(c->connect_event, 1);
+void DowowNetwork::Client::WaitForConnect() {
+    std::unique_lock<std::mutex> __tsfdm(mutex_tsfd);
+    connect_cv.wait(__tsfdm, [this]() { return !is_connecting && !connect_tasks; });
 }
 
-DowowNetwork::Client::Client() : Connection() {
+DowowNetwork::Client::Client(uint8_t io_backend) : Connection() {
+    SetIoBackend(io_backend);
 
+    connect_watcher.callback = ConnectEventFunc;
+    connect_watcher.owner = this;
+    connect_timer.callback = ConnectTimerFunc;
+    connect_timer.owner = this;
 }
 
-
 bool DowowNetwork::Client::ConnectTcp(std::string ip, uint16_t port, int timeout) {
-    // check if connected or connecting
-    if (IsConnected() || IsConnecting())
+    if (!ConnectTcpAsync(ip, port, timeout, ConnectCallback()))
         return false;
 
-    // temp socket fd
-    temp_socket_fd =
-        socket(AF_INET, SOCK_STREAM, 0);
+    WaitForConnect();
+    return IsConnected();
+}
 
-    // failed to create the temp socket
-    if (temp_socket_fd == -1)
+bool DowowNetwork::Client::ConnectUnix(std::string socket_path, int timeout) {
+    if (!ConnectUnixAsync(socket_path, timeout, ConnectCallback()))
         return false;
 
-    // make socket nonblocking
-    int nb_state = 1;
-    fcntl(temp_socket_fd, F_SETFL, nb_state);
-
-    // create event
-    connect_event = eventfd(0, 0);
+    WaitForConnect();
+    return IsConnected();
+}
 
-    std::thread t(TcpThreadFunc, this, ip, port, timeout);
-    t.detach();
+bool DowowNetwork::Client::ConnectTcpAsync(std::string ip, uint16_t port, int timeout, ConnectCallback callback) {
+    sockaddr_storage addr;
+    socklen_t length;
+    if (!MakeTcpAddress(ip, port, addr, length))
+        return false;
 
-    // read
-    Utils::ReadEventFd(connect_event, -1);
+    return StartConnect(reinterpret_cast<sockaddr*>(&addr), length, timeout, callback);
+}
 
-    // close event
-    close(connect_event);
-    connect_event = -1;
+bool DowowNetwork::Client::ConnectUnixAsync(std::string socket_path, int timeout, ConnectCallback callback) {
+    sockaddr_storage addr;
+    socklen_t length;
+    if (!MakeUnixAddress(socket_path, addr, length))
+        return false;
 
-    // return the result
-    return IsConnected();
+    return StartConnect(reinterpret_cast<sockaddr*>(&addr), length, timeout, callback);
 }
 
-bool DowowNetwork::Client::ConnectUnix(std::string socket_path, int timeout) {
-    // check if connected or connecting
-    if (IsConnected() || IsConnecting())
-        return false;
+std::future<bool> DowowNetwork::Client::ConnectTcpFuture(std::string ip, uint16_t port, int timeout) {
+    // shared with the callback
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = promise->get_future();
 
-    // temp socket fd
-    temp_socket_fd =
-        socket(AF_UNIX, SOCK_STREAM, 0);
+    bool is_started = ConnectTcpAsync(
+        ip,
+        port,
+        timeout,
+        [promise](Client *c, bool is_connected) { promise->set_value(is_connected); });
+    if (!is_started) promise->set_value(false);
 
-    // failed to create the temp socket
-    if (temp_socket_fd == -1)
-        return false;
+    return result;
+}
 
-    // make socket nonblocking
-    int nb_state = 1;
-    fcntl(temp_socket_fd, F_SETFL, nb_state);
+std::future<bool> DowowNetwork::Client::ConnectUnixFuture(std::string socket_path, int timeout) {
+    // shared with the callback
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = promise->get_future();
 
-    // create event
-    connect_event = eventfd(0, 0);
+    bool is_started = ConnectUnixAsync(
+        socket_path,
+        timeout,
+        [promise](Client *c, bool is_connected) { promise->set_value(is_connected); });
+    if (!is_started) promise->set_value(false);
 
-    // create a thread for connection
-    std::thread t(UnixThreadFunc, this, socket_path, timeout);
-    t.detach();
+    return result;
+}
 
-    // read
-    Utils::ReadEventFd(connect_event, -1);
+uint32_t DowowNetwork::Client::ConnectTcpMany(
+    const std::vector<Client*>& clients,
+    std::string ip,
+    uint16_t port,
+    int timeout)
+{
+    sockaddr_storage addr;
+    socklen_t length;
+    if (!MakeTcpAddress(ip, port, addr, length))
+        return 0;
+
+    // start everything, then wait for everything
+    for (auto c : clients)
+        c->StartConnect(reinterpret_cast<sockaddr*>(&addr), length, timeout, ConnectCallback());
+    uint32_t connected = 0;
+    for (auto c : clients) {
+        c->WaitForConnect();
+        if (c->IsConnected()) connected++;
+    }
 
-    // close event
-    close(connect_event);
-    connect_event = -1;
+    return connected;
+}
 
-    // return the result
-    return IsConnected();
+uint32_t DowowNetwork::Client::ConnectUnixMany(
+    const std::vector<Client*>& clients,
+    std::string socket_path,
+    int timeout)
+{
+    sockaddr_storage addr;
+    socklen_t length;
+    if (!MakeUnixAddress(socket_path, addr, length))
+        return 0;
+
+    // start everything, then wait for everything
+    for (auto c : clients)
+        c->StartConnect(reinterpret_cast<sockaddr*>(&addr), length, timeout, ConnectCallback());
+    uint32_t connected = 0;
+    for (auto c : clients) {
+        c->WaitForConnect();
+        if (c->IsConnected()) connected++;
+    }
+
+    return connected;
 }
 
 bool DowowNetwork::Client::IsConnecting() {
-    return temp_socket_fd != -1;
+    std::lock_guard<std::mutex> __tsfdm(mutex_tsfd);
+    return is_connecting;
+}
+
+void DowowNetwork::Client::CancelConnect() {
+    std::unique_lock<std::mutex> __tsfdm(mutex_tsfd);
+
+    // connection in progress - cancel it and wait for it to finish
+    if (temp_socket_fd != -1) PostConnectTask(&Client::AbortConnect);
+    connect_cv.wait(__tsfdm, [this]() { return !is_connecting && !connect_tasks; });
 }
 
 DowowNetwork::Client::~Client() {
-    // connection in progress - wait for it to finish
-    std::lock_guard<std::mutex> __tsfdm(mutex_tsfd);
+    CancelConnect();
 }
@@ -11,42 +11,169 @@
 #include "SocketType.hpp"
 
 #include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include <sys/socket.h>
 
 namespace DowowNetwork {
+    // declaration for typedef below
+    class Client;
+
+    //! Connection attempt completion callback.
+    /*!
+        \param client the client that was connecting
+        \param is_connected whether the attempt succeeded
+    */
+    typedef std::function<void(Client *client, bool is_connected)> ConnectCallback;
+
     /// Client
     /*!
         The endpoint that initiates the connection.
         This class is derived from connection as they share a lot.
+
+        The connection is established by the event loop that is going
+        to serve the client (see SetReactor()), no thread is spawned
+        per attempt.
     */
     class Client : public Connection {
     private:
-        // mutex for temp socket
+        // mutex for the connection attempt
         std::mutex mutex_tsfd;
+        // notified when the attempt is over
+        std::condition_variable connect_cv;
 
         // file descriptor for a socket trying to connect to the server
         int temp_socket_fd = -1;
+        // is the attempt (including its callback) in progress?
+        bool is_connecting = false;
+        //! The number of the attempt, the posted tasks check it.
+        uint32_t connect_attempt = 0;
+        //! Amount of the tasks posted to the connect loop and not run yet.
+        uint32_t connect_tasks = 0;
 
-        // connecting thread event
-        int connect_event = -1;
+        //! The address to connect to.
+        sockaddr_storage connect_addr;
+        //! The length of connect_addr.
+        socklen_t connect_addr_length = 0;
+        //! The moment the attempt times out, 0 for never.
+        uint64_t connect_deadline = 0;
+        //! The loop driving the attempt.
+        EventLoop *connect_loop = 0;
+        //! The watcher of the connecting socket.
+        Watcher connect_watcher;
+        //! The timer of the attempt (the timeout and the retries).
+        Timer connect_timer;
+        //! The completion callback, may be empty.
+        ConnectCallback connect_callback;
 
-        static void TcpThreadFunc(Client *client, std::string ip, uint16_t port, int timeout = 30);
-        static void UnixThreadFunc(Client *client, std::string unix_path, int timeout = 30);
+        //! The connecting socket is writable or failed.
+        static void ConnectEventFunc(Watcher *w, uint32_t events);
+        //! The attempt is timed out or must be retried.
+        static void ConnectTimerFunc(Timer *t);
+
+        //! Start the attempt.
+        /*! \return false if connected or connecting already, or if
+         *          the socket can't be created.
+         */
+        bool StartConnect(
+            const sockaddr *addr,
+            socklen_t length,
+            int timeout,
+            ConnectCallback callback);
+        //! Call connect() and watch for its result.
+        //! \warning Must be called from the connect loop thread.
+        void TryConnect();
+        //! Finish the attempt and call the callback.
+        //! \warning Must be called from the connect loop thread.
+        void FinishConnect(bool is_success);
+        //! Run the task of the attempt in the connect loop.
+        /*! The task is skipped if the attempt is over meanwhile.
+         *  \warning mutex_tsfd must be locked.
+         */
+        void PostConnectTask(void (Client::*task)());
+        //! Fail the attempt (the connect loop thread).
+        void AbortConnect();
+        //! Wait for the attempt and its tasks to finish.
+        void WaitForConnect();
+
+        //! Make the TCP address.
+        static bool MakeTcpAddress(std::string ip, uint16_t port, sockaddr_storage& addr, socklen_t& length);
+        //! Make the UNIX address.
+        static bool MakeUnixAddress(std::string socket_path, sockaddr_storage& addr, socklen_t& length);
     protected:
     public:
         /// Create a new client.
         /*!
             The created client will not be connected anywhere.
 
-            \param nonblocking must be nonblocking?
-            \sa ConnectTcp(), ConnectUnix().
+            \param io_backend the backend of the own polling thread,
+                   not used with a reactor
+            \sa ConnectTcp(), ConnectUnix(), IoBackend.
         */
-        Client();
+        explicit Client(uint8_t io_backend = IoBackendEpoll);
 
         /// Connect to a TCP server.
+        /*!
+            Blocks until connected or failed.
+            \warning Must not be called from the event loop thread
+                     serving the client.
+
+            \param timeout seconds to wait, negative for infinity
+            \return true if connected.
+        */
         bool ConnectTcp(std::string ip, uint16_t port, int timeout = 30);
         /// Connect to a UNIX server.
+        /*! \sa ConnectTcp(). */
         bool ConnectUnix(std::string socket_path, int timeout = 30);
 
+        /// Start connecting to a TCP server.
+        /*!
+            Returns immediately. The callback is called exactly once
+            in the event loop thread when the client is connected, the
+            attempt fails or times out, so it must not block.
+            IsConnecting() is true until the callback returns.
+
+            \param timeout seconds to wait, negative for infinity
+            \param callback the completion callback, may be empty
+            \return false if connected or connecting already, or if the
+                    address is invalid (the callback is not called then).
+        */
+        bool ConnectTcpAsync(std::string ip, uint16_t port, int timeout, ConnectCallback callback);
+        /// Start connecting to a UNIX server.
+        /*! \sa ConnectTcpAsync(). */
+        bool ConnectUnixAsync(std::string socket_path, int timeout, ConnectCallback callback);
+
+        /// Start connecting to a TCP server and get the future result.
+        /*! \sa ConnectTcpAsync(). */
+        std::future<bool> ConnectTcpFuture(std::string ip, uint16_t port, int timeout = 30);
+        /// Start connecting to a UNIX server and get the future result.
+        /*! \sa ConnectTcpAsync(). */
+        std::future<bool> ConnectUnixFuture(std::string socket_path, int timeout = 30);
+
+        /// Connect many clients to a TCP server at once.
+        /*!
+            All the attempts are in progress concurrently and share
+            the timeout.
+
+            \param clients the clients to connect
+            \param timeout seconds to wait, negative for infinity
+            \return The amount of the connected clients.
+        */
+        static uint32_t ConnectTcpMany(
+            const std::vector<Client*>& clients,
+            std::string ip,
+            uint16_t port,
+            int timeout = 30);
+        /// Connect many clients to a UNIX server at once.
+        /*! \sa ConnectTcpMany(). */
+        static uint32_t ConnectUnixMany(
+            const std::vector<Client*>& clients,
+            std::string socket_path,
+            int timeout = 30);
+
         /// Check if connecting right now.
         /*!
             \return
@@ -56,9 +183,18 @@ namespace DowowNetwork {
         */
         bool IsConnecting();
 
+        /// Cancel the connection attempt.
+        /*!
+            Blocks until the attempt is over, the callback is called
+            with is_connected = false unless connected meanwhile.
+            Does nothing if not connecting.
+            \warning Must not be called from the callback.
+        */
+        void CancelConnect();
+
         /// Client destructor.
         /*!
-            Disconnects if needed.
+            Cancels the connection attempt and disconnects if needed.
         */
         ~Client();
     };
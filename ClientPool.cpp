@@ -0,0 +1,242 @@
+#include "ClientPool.hpp"
+
+#include <sys/epoll.h>
+
+#include "Utils.hpp"
+
+// the delay before the next attempt after a failed one (milliseconds)
+#define REFILL_RETRY_MS 1000
+
+void DowowNetwork::ClientPool::StoppedFunc(Watcher *w, uint32_t events) {
+    Member *m = reinterpret_cast<Member*>(w->owner);
+
+    // the event stays readable until the client is connected again
+    m->pool->loop->Remove(w);
+    m->is_watched = false;
+
+    m->pool->Refill(m);
+}
+
+void DowowNetwork::ClientPool::RefillFunc(Timer *t) {
+    Member *m = reinterpret_cast<Member*>(t->owner);
+    m->pool->Refill(m);
+}
+
+void DowowNetwork::ClientPool::Refill(Member *m) {
+    // Stop() doesn't miss the attempt started meanwhile
+    std::lock_guard<std::mutex> __pm(mutex_pool);
+
+    // stopped
+    if (!is_started) return;
+
+    // the result comes back to the loop thread
+    ConnectCallback callback = [m](Client *c, bool is_connected) {
+        ClientPool *p = m->pool;
+        p->loop->Post([p, m, is_connected]() {
+            std::lock_guard<std::mutex> __pm(p->mutex_pool);
+            p->FinishRefill(m, is_connected);
+            p->attempts--;
+            p->attempts_cv.notify_all();
+        });
+    };
+    bool is_connecting = is_tcp ?
+        m->client->ConnectTcpAsync(address, port, connect_timeout, callback) :
+        m->client->ConnectUnixAsync(address, connect_timeout, callback);
+
+    if (is_connecting) {
+        attempts++;
+    } else {
+        // not stopped yet, or the socket can't be created
+        FinishRefill(m, m->client->IsConnected());
+    }
+}
+
+void DowowNetwork::ClientPool::FinishRefill(Member *m, bool is_connected) {
+    // stopped meanwhile
+    if (!is_started) return;
+
+    if (is_connected) {
+        // reconnect once dropped
+        loop->Add(&m->stopped_watcher, m->client->GetStoppedEvent(), EPOLLIN);
+        m->is_watched = true;
+    } else {
+        // try again later
+        loop->StartTimer(&m->refill_timer, Utils::GetMonotonicMS() + REFILL_RETRY_MS);
+    }
+}
+
+bool DowowNetwork::ClientPool::Start(bool is_tcp, std::string address, uint16_t port, int timeout) {
+    {
+        std::lock_guard<std::mutex> __pm(mutex_pool);
+        if (is_started) return false;
+        is_started = true;
+
+        // the endpoint to refill the pool with
+        this->is_tcp = is_tcp;
+        this->address = address;
+        this->port = port;
+        connect_timeout = timeout;
+    }
+
+    // connect everything at once
+    std::vector<Client*> clients;
+    for (auto m : members) clients.push_back(m->client);
+    uint32_t connected = is_tcp ?
+        Client::ConnectTcpMany(clients, address, port, timeout) :
+        Client::ConnectUnixMany(clients, address, timeout);
+
+    // the server is unreachable
+    if (!connected) {
+        std::lock_guard<std::mutex> __pm(mutex_pool);
+        is_started = false;
+        return false;
+    }
+
+    // watch the connected ones, retry the rest
+    loop->Post([this]() {
+        std::lock_guard<std::mutex> __pm(mutex_pool);
+        for (auto m : members) FinishRefill(m, m->client->IsConnected());
+    });
+
+    return true;
+}
+
+DowowNetwork::Client* DowowNetwork::ClientPool::Pick() {
+    Client *c = GetLeastLoaded();
+    // the call fails the usual way
+    return c ? c : members[0]->client;
+}
+
+DowowNetwork::ClientPool::ClientPool(
+    uint32_t size,
+    Reactor *reactor,
+    uint8_t io_backend) :
+    next_member(0)
+{
+    // at least one
+    if (!size) size = 1;
+
+    for (uint32_t i = 0; i < size; ++i) {
+        Member *m = new Member();
+        m->pool = this;
+        m->client = new Client(io_backend);
+        m->client->SetReactor(reactor);
+        m->stopped_watcher.callback = StoppedFunc;
+        m->stopped_watcher.owner = m;
+        m->refill_timer.callback = RefillFunc;
+        m->refill_timer.owner = m;
+        members.push_back(m);
+    }
+
+    // the monitoring is cheap, one thread is enough
+    loop = new EventLoop(io_backend);
+}
+
+bool DowowNetwork::ClientPool::StartTcp(std::string ip, uint16_t port, int timeout) {
+    return Start(true, ip, port, timeout);
+}
+
+bool DowowNetwork::ClientPool::StartUnix(std::string socket_path, int timeout) {
+    return Start(false, socket_path, 0, timeout);
+}
+
+void DowowNetwork::ClientPool::Stop() {
+    {
+        std::lock_guard<std::mutex> __pm(mutex_pool);
+        if (!is_started) return;
+        is_started = false;
+    }
+
+    // no attempts are started from now on, finish the ones in progress
+    for (auto m : members) m->client->CancelConnect();
+    {
+        std::unique_lock<std::mutex> __pm(mutex_pool);
+        attempts_cv.wait(__pm, [this]() { return !attempts; });
+    }
+
+    // stop monitoring
+    std::promise<void> stopped;
+    loop->Post([this, &stopped]() {
+        for (auto m : members) {
+            if (m->is_watched) loop->Remove(&m->stopped_watcher);
+            m->is_watched = false;
+            loop->StopTimer(&m->refill_timer);
+        }
+        stopped.set_value();
+    });
+    stopped.get_future().wait();
+
+    // disconnect
+    for (auto m : members) m->client->Disconnect(true, true);
+}
+
+bool DowowNetwork::ClientPool::IsStarted() {
+    std::lock_guard<std::mutex> __pm(mutex_pool);
+    return is_started;
+}
+
+uint32_t DowowNetwork::ClientPool::GetSize() {
+    return members.size();
+}
+
+uint32_t DowowNetwork::ClientPool::GetConnectedAmount() {
+    uint32_t connected = 0;
+    for (auto m : members) {
+        if (m->client->GetState() == ConnectionStateConnected) connected++;
+    }
+    return connected;
+}
+
+DowowNetwork::Client* DowowNetwork::ClientPool::GetClient(uint32_t index) {
+    return index < members.size() ? members[index]->client : 0;
+}
+
+DowowNetwork::Client* DowowNetwork::ClientPool::GetLeastLoaded() {
+    // the equally loaded ones are taken in turn
+    uint32_t start = next_member++;
+
+    Client *result = 0;
+    uint32_t result_calls = 0, result_bytes = 0;
+    for (uint32_t i = 0; i < members.size(); ++i) {
+        Client *c = members[(start + i) % members.size()]->client;
+        if (c->GetState() != ConnectionStateConnected) continue;
+
+        // the fewest calls, then the fewest bytes to send
+        uint32_t calls = c->GetPendingCallsAmount();
+        uint32_t bytes = c->GetUnsentBytes();
+        if (!result || calls < result_calls ||
+            (calls == result_calls && bytes < result_bytes))
+        {
+            result = c;
+            result_calls = calls;
+            result_bytes = bytes;
+        }
+    }
+
+    return result;
+}
+
+DowowNetwork::Request* DowowNetwork::ClientPool::Push(const Request& r, int timeout, uint8_t priority) {
+    return Pick()->Push(r, timeout, true, priority);
+}
+
+bool DowowNetwork::ClientPool::PushAsync(const Request& r, int timeout, ResponseCallback callback, uint8_t priority) {
+    return Pick()->PushAsync(r, timeout, callback, true, priority);
+}
+
+std::future<DowowNetwork::Request*> DowowNetwork::ClientPool::PushFuture(const Request& r, int timeout, uint8_t priority) {
+    return Pick()->PushFuture(r, timeout, true, priority);
+}
+
+DowowNetwork::ClientPool::~ClientPool() {
+    Stop();
+
+    // nothing is watched anymore
+    delete loop;
+
+    for (auto m : members) {
+        delete m->client;
+        delete m;
+    }
+    members.clear();
+}
@@ -0,0 +1,169 @@
+/*!
+    \file
+
+    This file defines the ClientPool class.
+*/
+
+#ifndef __DOWOW_NETWORK__CLIENT_POOL_H_
+#define __DOWOW_NETWORK__CLIENT_POOL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+#include "Client.hpp"
+#include "EventLoop.hpp"
+#include "Reactor.hpp"
+
+namespace DowowNetwork {
+    //! A set of clients connected to the same server.
+    /*!
+        One connection has one send queue served by one thread, so it
+        limits the request rate. The pool keeps several connections to
+        the same endpoint and sends each request over the least loaded
+        one: with the fewest calls waiting for the responses, then with
+        the fewest bytes not sent yet.
+
+        The dropped connections are reestablished in the background,
+        the failed attempts are retried every second.
+
+        \warning
+            Set the handlers of the clients (see GetClient()) before
+            the pool is started.
+    */
+    class ClientPool {
+    private:
+        //! A client of the pool.
+        struct Member {
+            //! The pool.
+            ClientPool *pool = 0;
+            //! The client.
+            Client *client = 0;
+            //! Watches the stopped event of the client.
+            Watcher stopped_watcher;
+            //! Fires the next connection attempt.
+            Timer refill_timer;
+            //! Is the stopped event watched?
+            bool is_watched = false;
+        };
+
+        //! mutex for the state and the endpoint
+        std::mutex mutex_pool;
+        //! Notified when an attempt is over.
+        std::condition_variable attempts_cv;
+
+        //! The members, not changed after the construction.
+        std::vector<Member*> members;
+        //! The member to start looking for the least loaded from.
+        std::atomic<uint32_t> next_member;
+        //! The loop monitoring the members.
+        EventLoop *loop = 0;
+
+        //! Is the pool started?
+        bool is_started = false;
+        //! Amount of the connection attempts in progress.
+        uint32_t attempts = 0;
+        //! Is the endpoint TCP or UNIX?
+        bool is_tcp = false;
+        //! The IP or the socket path.
+        std::string address;
+        //! The TCP port.
+        uint16_t port = 0;
+        //! The connection timeout, seconds.
+        int connect_timeout = 30;
+
+        //! The stopped event of a client is readable.
+        static void StoppedFunc(Watcher *w, uint32_t events);
+        //! It's time to reconnect a client.
+        static void RefillFunc(Timer *t);
+
+        //! Start connecting the member.
+        //! \warning Must be called from the loop thread.
+        void Refill(Member *m);
+        //! Watch the connected member or schedule the next attempt.
+        /*! \warning Must be called from the loop thread,
+         *           mutex_pool must be locked.
+         */
+        void FinishRefill(Member *m, bool is_connected);
+        //! Connect all the clients and start monitoring them.
+        bool Start(bool is_tcp, std::string address, uint16_t port, int timeout);
+        //! Get the least loaded client, any client if none is connected.
+        Client* Pick();
+    public:
+        /// Create the pool.
+        /*!
+            The clients are not connected until the pool is started.
+
+            \param size the amount of connections
+            \param reactor the reactor to serve the clients,
+                   null-pointer for a polling thread per client
+            \param io_backend the backend of the polling threads
+        */
+        explicit ClientPool(
+            uint32_t size,
+            Reactor *reactor = 0,
+            uint8_t io_backend = IoBackendEpoll);
+
+        /// Connect to a TCP server.
+        /*!
+            Connects all the clients at once and starts refilling the
+            pool. The clients that failed to connect are retried in the
+            background.
+
+            \param timeout seconds to wait, negative for infinity
+            \return false if started already, the address is invalid or
+                    no client could connect (the pool isn't started then).
+        */
+        bool StartTcp(std::string ip, uint16_t port, int timeout = 30);
+        /// Connect to a UNIX server.
+        /*! \sa StartTcp(). */
+        bool StartUnix(std::string socket_path, int timeout = 30);
+
+        /// Disconnect all the clients and stop refilling the pool.
+        /*! The pending calls are completed with null-pointers. */
+        void Stop();
+
+        /// Check if the pool is started.
+        bool IsStarted();
+
+        /// Get the amount of clients.
+        uint32_t GetSize();
+        /// Get the amount of connected clients.
+        uint32_t GetConnectedAmount();
+        /// Get the client by its index.
+        /*! \return The client or null-pointer if the index is invalid. */
+        Client* GetClient(uint32_t index);
+        /// Get the least loaded connected client.
+        /*! MT-Safe. \return The client or null-pointer if none is connected. */
+        Client* GetLeastLoaded();
+
+        /// Push the Request over the least loaded connection.
+        /*! MT-Safe. \sa Connection::Push(). */
+        Request* Push(
+            const Request& r,
+            int timeout = 0,
+            uint8_t priority = SendPriorityNormal);
+        /// Push the Request and get the response asynchronously.
+        /*! MT-Safe. \sa Connection::PushAsync(). */
+        bool PushAsync(
+            const Request& r,
+            int timeout,
+            ResponseCallback callback,
+            uint8_t priority = SendPriorityNormal);
+        /// Push the Request and get the future response.
+        /*! MT-Safe. \sa Connection::PushFuture(). */
+        std::future<Request*> PushFuture(
+            const Request& r,
+            int timeout = -1,
+            uint8_t priority = SendPriorityNormal);
+
+        /// Stop the pool and delete the clients.
+        ~ClientPool();
+    };
+}
+
+#endif
@@ -1,15 +1,23 @@
 #include "Connection.hpp"
 
 #include <cstring>
+#include <cerrno>
 #include <endian.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/eventfd.h>
-#include <sys/timerfd.h>
 #include <ctime>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include <unistd.h>
 
 #include "Utils.hpp"
@@ -28,163 +36,262 @@ using namespace std;
 
 #define MTLock(name, mut) std::lock_guard<typeof(mut)> name(mut);
 
+// the maximum amount of bytes received by one recv()
+#define RECV_CHUNK_MAX 65536
+// the maximum amount of requests gathered into one sendmsg()
+#define SEND_FRAMES_MAX IOV_MAX
+
+// the refs_amount bit set while the stopped connection awaits the release
+#define REFS_AWAITING_RELEASE 0x80000000u
+
+void DowowNetwork::Connection::HoldStart(bool is_receiving) {
+    this->is_receiving = is_receiving;
+
+    // referenced until StartReceiving() or SetReceiving()
+    if (!is_receiving) {
+        is_start_held = true;
+        IncreaseRefs();
+    }
+}
+
+void DowowNetwork::Connection::WakeLoop() {
+    // the push watcher updates the socket events,
+    // the notifications are merged until it's invoked
+    if (!is_push_pending.exchange(true))
+        loop->Notify(&push_watcher);
+}
+
 bool DowowNetwork::Connection::HasSomethingToSend() {
-    MTLock(__msq, mutex_sq);
-    return
-        send_queue.size() ||
-        send_buffer_length != send_buffer_offset;
+    if (send_frames.size()) return true;
+    for (auto& q : send_queues)
+        if (!q.IsEmpty()) return true;
+    return false;
 }
 
-void DowowNetwork::Connection::ConnThreadFunc(Connection* c) {
-    while (true) {
-        // lock connected/disconnecting mutex
-        c->mutex_cd.lock();
-        // create the fds for poll
-        pollfd pollfds[5];
-        // add 'to_stop' event
-        pollfds[0].fd = c->to_stop_event;
-        pollfds[0].events = POLLIN;
-        // add socket fd
-        // remark:  we wait for input only if not disconnecting,
-        //          we wait for output only if we have something
-        //          to send.
-        pollfds[1].fd = c->socket_fd;
-        pollfds[1].events =
-            (!c->is_disconnecting ? POLLIN : 0) |
-            (c->HasSomethingToSend() ? POLLOUT : 0);
-        // our still-alive timer
-        pollfds[2].fd = c->our_sa_timer;
-        pollfds[2].events = POLLIN;
-        // their not-alive timer
-        pollfds[3].fd = c->their_na_timer;
-        pollfds[3].events = POLLIN;
-        // push event
-        pollfds[4].fd = c->push_event;
-        pollfds[4].events = POLLIN;
-        // unlock connected/disconnecting mutex
-        c->mutex_cd.unlock();
-
-        // let's poll!
-        poll(
-            pollfds,
-            sizeof(pollfds) / sizeof(pollfds[0]),
-            -1);
-
-        // lock connected/disconnecting mutex
-        MTLock(__mcd, c->mutex_cd);
-
-        // ***************
-        // 'to_stop' event
-        // ***************
-        if (pollfds[0].revents & POLLIN) {
-            uint64_t void_val;
-            read(pollfds[0].fd, &void_val, sizeof(void_val));
-            break;
-        }
+void DowowNetwork::Connection::ConnEventFunc(Watcher *w, uint32_t events) {
+    Connection *c = reinterpret_cast<Connection*>(w->owner);
 
-        // *************
-        // socket events
-        // *************
-        if (pollfds[1].revents & POLLIN) {
+    // notified right before the stop
+    if (!c->IsPolling()) return;
+
+    // ***************
+    // 'to_stop' event
+    // ***************
+    if (w == &c->to_stop_watcher) {
+        c->StopPolling();
+        return;
+    }
+
+    // *************
+    // socket events
+    // *************
+    if (w == &c->socket_watcher) {
+        if (events & EPOLLIN) {
             if (!c->Receive()) {
                 // error
-                break;
+                c->StopPolling();
+                return;
             }
         }
-        if (pollfds[1].revents & POLLOUT) {
+        if (events & EPOLLOUT) {
             if (!c->Send()) {
                 // error
-                break;
+                c->StopPolling();
+                return;
             }
         }
-        // *********************
-        // our still-alive event
-        // *********************
-        if (pollfds[2].revents & POLLIN) {
-            Request *keep_alive = new Request("_");
-            c->Push(keep_alive, false, 0, false);
-
-            // read the value (or else the timer will break)
-            uint64_t void_buf;
-            read(pollfds[2].fd, &void_buf, sizeof(void_buf));
-
-            // update the timeout
-            Utils::SetTimerFdTimeout(
-                c->our_sa_timer,
-                c->our_sa_interval);
-        }
-        // *********************
-        // their not-alive event
-        // *********************
-        if (pollfds[3].revents & POLLIN) {
-            // close, they're timed out.
-            break;
+        // hung up and there's nothing to read
+        if ((events & (EPOLLHUP | EPOLLERR)) && !(events & EPOLLIN)) {
+            c->StopPolling();
+            return;
         }
-        // **********
-        // push event
-        // **********
-        if (pollfds[4].revents & POLLIN) {
-            uint64_t void_val;
-            read(pollfds[4].fd, &void_val, sizeof(void_val));
+    }
+
+    // **********
+    // push event
+    // **********
+    if (w == &c->push_watcher) {
+        // the next Push() wakes the loop up again
+        c->is_push_pending = false;
+        // the overflow might be reported after the queue is drained
+        c->CheckLowWatermark();
+    }
+
+    // the send queue might have changed
+    c->UpdateSocketEvents();
+}
+
+void DowowNetwork::Connection::ConnTimerFunc(Timer *t) {
+    Connection *c = reinterpret_cast<Connection*>(t->owner);
+
+    // restarted by another thread right before the stop
+    if (!c->IsPolling()) return;
+
+    // *********************
+    // our still-alive timer
+    // *********************
+    if (t == &c->our_sa_timer) {
+        // remark:  not held back by the bulk requests
+        //          nor by the send watermarks
+        Request *keep_alive = new Request("_");
+        c->Enqueue(keep_alive, false, false, 0, 0, SendPriorityControl, false);
+
+        // restart the timer
+        c->loop->StartTimer(
+            t,
+            Utils::GetMonotonicMS() + c->our_sa_interval * 1000);
+    }
+
+    // *********************
+    // their not-alive timer
+    // *********************
+    if (t == &c->their_na_timer) {
+        // close, they're timed out.
+        c->StopPolling();
+        return;
+    }
+
+    // ************************
+    // asynchronous calls timer
+    // ************************
+    if (t == &c->calls_timer) {
+        c->ExpirePendingCalls();
+    }
+
+    // the send queue might have changed
+    c->UpdateSocketEvents();
+}
+
+void DowowNetwork::Connection::ConnDataFunc(Watcher *w, const char *data, int32_t length) {
+    Connection *c = reinterpret_cast<Connection*>(w->owner);
+
+    // closed, failed or broken data
+    if (length <= 0 || !c->Consume(data, length)) {
+        c->StopPolling();
+        return;
+    }
+
+    // the handlers might have pushed something
+    c->UpdateSocketEvents();
+}
+
+void DowowNetwork::Connection::UpdateSocketEvents() {
+    bool is_draining = state == ConnectionStateDraining;
+    bool has_something_to_send = HasSomethingToSend();
+
+    // drained, the graceful disconnection is finished
+    if (is_draining && !has_something_to_send) {
+        is_drained = true;
+        StopPolling();
+        return;
+    }
+
+    // resumed, the bytes read while paused go first
+    if (!is_draining && is_receiving && !is_recv_full && recv_backlog.size()) {
+        if (!ConsumeBacklog()) {
+            StopPolling();
+            return;
         }
+        // the handlers might have pushed something
+        has_something_to_send = HasSomethingToSend();
     }
 
-    // lock the connected/disconnecting mutex
-    MTLock(__mcd, c->mutex_cd);
+    // remark:  we wait for input only if not disconnecting
+    //          (nor paused), we wait for output only if we have
+    //          something to send.
+    loop->Modify(
+        &socket_watcher,
+        (!is_draining && is_receiving && !is_recv_full ? EPOLLIN : 0) |
+        (has_something_to_send ? EPOLLOUT : 0));
+}
 
-    // mark as disconnecting
-    c->is_disconnecting = true;
+bool DowowNetwork::Connection::IsPolling() {
+    uint8_t s = state;
+    return
+        s == ConnectionStateConnecting ||
+        s == ConnectionStateConnected ||
+        s == ConnectionStateDraining;
+}
+
+void DowowNetwork::Connection::StopPolling() {
+    // mark as stopping (once)
+    uint8_t s = state;
+    do {
+        if (s == ConnectionStateStopping || s == ConnectionStateStopped)
+            return;
+    } while (!state.compare_exchange_weak(s, ConnectionStateStopping));
+
+    // stop monitoring the descriptors
+    loop->Remove(&socket_watcher);
+    loop->Remove(&to_stop_watcher);
+    loop->Remove(&push_watcher);
+    loop->StopTimer(&our_sa_timer);
+    loop->StopTimer(&their_na_timer);
+
+    // the responses won't come anymore
+    CancelPendingCalls();
+
+    // nothing will be sent anymore
+    NotifySendSpace();
 
     // notify the Pull() callers that the receive is finished
-    if (c->receive_event != -1) {
-        Utils::WriteEventFd(c->receive_event, 1);
-        close(c->receive_event);
-    }
-
-    // lock the reference counter
-    c->mutex_ra.lock();
-    // still referenced by external code, setup event
-    if (c->GetRefs())
-        c->not_needed_event = eventfd(0, 0);
-    // unlock the reference counter
-    c->mutex_ra.unlock();
-
-    // needed by someone
-    if (c->not_needed_event != -1) {
-        // wait until the Connection is not needed anymore
-        Utils::SelectRead(c->not_needed_event, -1);
-
-        // close the event
-        close(c->not_needed_event);
-        c->not_needed_event = -1;
-    }
-
-    // close (almost) everything
-    shutdown(c->socket_fd, SHUT_RDWR);
-    close(c->socket_fd);
-    close(c->push_event);
-    close(c->to_stop_event);
-    close(c->our_sa_timer);
-    close(c->their_na_timer);
-
-    // delete buffers
-    c->DeleteSendBuffer();
-    c->DeleteRecvBuffer();
-    // delete the send queue
-    c->mutex_sq.lock();
-    while (c->send_queue.size()) {
-        delete c->send_queue.front();
-        c->send_queue.pop();
-    }
-    c->mutex_sq.unlock();
-    // ... but do not delete the receive queue,
-    //     it might be needed after disconnection.
-
-    // mark as undefined
-    c->socket_type = SocketTypeUndefined;
+    mutex_rq.lock();
+    receive_wakeups++;
+    if (pull_waiters) receive_cv.notify_all();
+    mutex_rq.unlock();
+
+    // ... and the PullAsync() callers
+    CancelPullCallbacks();
+
+    // if still referenced by external code, DecreaseRefs() will finalize
+    refs_amount |= REFS_AWAITING_RELEASE;
+    FinalizeIfReleased();
+}
+
+void DowowNetwork::Connection::FinalizeIfReleased() {
+    // the stopped connection awaits loneliness ;-(
+    uint32_t released = REFS_AWAITING_RELEASE;
+    if (!refs_amount.compare_exchange_strong(released, 0)) return;
+
+    // finalize after the current batch of events is processed,
+    // so the watchers stay valid until then
+    loop->Post([this]() { Finalize(); });
+}
+
+void DowowNetwork::Connection::Finalize() {
+    {
+        // the timers might be restarted by the released refs
+        loop->StopTimer(&our_sa_timer);
+        loop->StopTimer(&their_na_timer);
+        loop->StopTimer(&calls_timer);
+
+        // close (almost) everything
+        shutdown(socket_fd, SHUT_RDWR);
+        close(socket_fd);
+
+        // delete buffers
+        DeleteSendBuffer();
+        DeleteRecvBuffer();
+        recv_backlog.clear();
+        // delete the send queue
+        Request *req;
+        for (auto& q : send_queues)
+            while (q.Pop(req)) delete req;
+        unsent_bytes = 0;
+        // ... but do not delete the receive queue,
+        //     it might be needed after disconnection.
+
+        // the loop doesn't serve us anymore
+        loop->Detach();
+
+        // mark as stopped
+        state = ConnectionStateStopped;
+    }
 
     // notify about stop
-    Utils::WriteEventFd(c->stopped_event, 1);
+    // remark:  the connection may be deleted right after that,
+    //          so it must be the last thing done
+    Utils::WriteEventFd(stopped_event, 1);
 }
 
 bool DowowNetwork::Connection::PassThroughHandlers(Request* r) {
@@ -192,6 +299,8 @@ bool DowowNetwork::Connection::PassThroughHandlers(Request* r) {
     if (!r) return false;
 
     // get the named handler
+    // remark:  called outside of the lock, so the handler may
+    //          change the handlers
     auto h = GetHandlerNamed(r->GetName());
     // try to handle
     if (h) {
@@ -211,19 +320,290 @@ bool DowowNetwork::Connection::PassThroughHandlers(Request* r) {
     return false;
 }
 
-DowowNetwork::Connection::Connection() {
+bool DowowNetwork::Connection::AddPendingCall(uint32_t id, PendingCall *call, int timeout) {
+    MTLock(__mpc, mutex_pc);
+
+    // no responses will come anymore
+    if (is_calls_closed) return false;
+
+    call->id = id;
+    pending_calls[id] = call;
+
+    // the asynchronous calls are expired by the timer
+    if (call->callback && timeout >= 0) {
+        call->has_deadline = true;
+        call->deadline_it = call_deadlines.insert(std::make_pair(
+            Utils::GetMonotonicMS() + static_cast<uint64_t>(timeout) * 1000,
+            id));
+        // the earliest one
+        if (call->deadline_it == call_deadlines.begin())
+            ArmCallsTimer();
+    }
+
+    return true;
+}
+
+DowowNetwork::Request* DowowNetwork::Connection::WaitPendingCall(PendingCall *call, int timeout) {
+    std::unique_lock<std::mutex> __mpc(mutex_pc);
+
+    // wait for the response, the disconnection or the timeout
+    if (timeout < 0) {
+        while (!call->is_done) call->cv.wait(__mpc);
+    } else {
+        call->cv.wait_for(
+            __mpc,
+            std::chrono::seconds(timeout),
+            [call]() { return call->is_done; });
+    }
+
+    // timed out, the late response is handled as a usual request
+    if (!call->is_done) pending_calls.erase(call->id);
+
+    return call->response;
+}
+
+bool DowowNetwork::Connection::CompletePendingCall(Request* r) {
+    std::unique_lock<std::mutex> __mpc(mutex_pc);
+
+    // not a response we're waiting for
+    auto it = pending_calls.find(r->GetId());
+    if (it == pending_calls.end()) return false;
+
+    PendingCall *call = it->second;
+    pending_calls.erase(it);
+    call->response = r;
+
+    // wake the caller up
+    if (!call->callback) {
+        call->is_done = true;
+        call->cv.notify_one();
+        return true;
+    }
+
+    // not expiring anymore
+    if (call->has_deadline) call_deadlines.erase(call->deadline_it);
+
+    // the callback may call us
+    __mpc.unlock();
+    call->callback(this, r);
+    delete call;
+
+    return true;
+}
+
+void DowowNetwork::Connection::CancelPendingCalls() {
+    // the asynchronous calls to complete
+    std::vector<PendingCall*> cancelled;
+
+    mutex_pc.lock();
+
+    // the blocked callers get null-pointers
+    for (auto& i : pending_calls) {
+        if (i.second->callback) {
+            cancelled.push_back(i.second);
+        } else {
+            i.second->is_done = true;
+            i.second->cv.notify_one();
+        }
+    }
+    pending_calls.clear();
+    call_deadlines.clear();
+    ArmCallsTimer();
+
+    // until the next connection
+    is_calls_closed = true;
+
+    mutex_pc.unlock();
+
+    // the callbacks get null-pointers
+    for (auto call : cancelled) {
+        call->callback(this, 0);
+        delete call;
+    }
+}
+
+void DowowNetwork::Connection::CancelPullCallbacks() {
+    // take the callbacks
+    std::queue<ResponseCallback> cancelled;
+    mutex_rq.lock();
+    cancelled.swap(pull_callbacks);
+    mutex_rq.unlock();
+
+    // nothing will be received anymore
+    while (cancelled.size()) {
+        cancelled.front()(this, 0);
+        cancelled.pop();
+    }
+}
+
+void DowowNetwork::Connection::ExpirePendingCalls() {
+    // the asynchronous calls to complete
+    std::vector<PendingCall*> expired;
+
+    mutex_pc.lock();
+
+    // take the calls which deadlines passed
+    uint64_t now = Utils::GetMonotonicMS();
+    while (call_deadlines.size() && call_deadlines.begin()->first <= now) {
+        auto it = pending_calls.find(call_deadlines.begin()->second);
+        expired.push_back(it->second);
+        pending_calls.erase(it);
+        call_deadlines.erase(call_deadlines.begin());
+    }
+    ArmCallsTimer();
+
+    mutex_pc.unlock();
+
+    // the callbacks get null-pointers
+    for (auto call : expired) {
+        call->callback(this, 0);
+        delete call;
+    }
+}
+
+void DowowNetwork::Connection::ArmCallsTimer() {
+    if (call_deadlines.size())
+        loop->StartTimer(&calls_timer, call_deadlines.begin()->first);
+    else
+        loop->StopTimer(&calls_timer);
+}
+
+void DowowNetwork::Connection::DispatchReceived(Request* r) {
+    // the response to a pending Push()
+    if (CompletePendingCall(r)) return;
+
+    // the pool may be changed by other threads
+    mutex_hq.lock();
+    HandlerPool *pool = handler_pool;
+    mutex_hq.unlock();
+
+    // handle right here
+    if (!pool) {
+        if (!PassThroughHandlers(r)) PushReceived(r);
+        return;
+    }
+
+    // no handler for it
+    if (!GetHandlerNamed(r->GetName()) && !GetHandlerDefault()) {
+        PushReceived(r);
+        return;
+    }
+
+    // lock the handler queue
+    MTLock(__mhq, mutex_hq);
+
+    // the order is kept by the queue
+    handler_queue.push(r);
+
+    // the queue is handled by one task at a time
+    if (!is_handler_scheduled) {
+        is_handler_scheduled = true;
+        IncreaseRefs();
+        pool->Post([this]() { RunHandlers(); });
+    }
+}
+
+void DowowNetwork::Connection::PushReceived(Request* r) {
+    mutex_rq.lock();
+
+    // someone is waiting for it asynchronously
+    if (pull_callbacks.size()) {
+        ResponseCallback callback = pull_callbacks.front();
+        pull_callbacks.pop();
+        mutex_rq.unlock();
+
+        callback(this, r);
+        return;
+    }
+
+    recv_queue.push(r);
+
+    // stop reading, the loop updates the socket events after that
+    uint32_t limit = recv_queue_limit;
+    if (limit && recv_queue.size() >= limit) is_recv_full = true;
+
+    // queue updated, notify outer code
+    if (pull_waiters) receive_cv.notify_one();
+    mutex_rq.unlock();
+}
+
+void DowowNetwork::Connection::ResumeIfPulled() {
+    if (!is_recv_full) return;
+
+    // a half is pulled (or the limit is raised)
+    uint32_t limit = recv_queue_limit;
+    if (limit && recv_queue.size() > limit / 2) return;
+    is_recv_full = false;
+
+    // not finalized while referenced
+    IncreaseRefs();
+    if (state == ConnectionStateConnected) WakeLoop();
+    DecreaseRefs();
+}
+
+void DowowNetwork::Connection::RunHandlers() {
+    while (true) {
+        // take the next request
+        mutex_hq.lock();
+        if (!handler_queue.size()) {
+            is_handler_scheduled = false;
+            mutex_hq.unlock();
+            break;
+        }
+        Request *r = handler_queue.front();
+        handler_queue.pop();
+        mutex_hq.unlock();
+
+        // the handler might have been reset meanwhile
+        if (!PassThroughHandlers(r)) PushReceived(r);
+    }
+
+    // the connection might be waiting for us to finalize
+    DecreaseRefs();
+}
+
+DowowNetwork::Connection::Connection() :
+    free_request_id(1),
+    state(ConnectionStateStopped),
+    is_drained(false),
+    unsent_bytes(0),
+    send_high_watermark(0),
+    send_low_watermark(0),
+    overflow_mode(OverflowModeBlock),
+    is_send_high(false),
+    overflows_amount(0),
+    is_receiving(true),
+    is_start_held(false),
+    recv_queue_limit(0),
+    is_recv_full(false),
+    is_push_pending(false),
+    refs_amount(0)
+{
     DeleteSendBuffer();
     DeleteRecvBuffer();
 
+    // all the watchers are handled by ConnEventFunc()
+    for (Watcher *w : { &socket_watcher, &to_stop_watcher, &push_watcher }) {
+        w->callback = ConnEventFunc;
+        w->owner = this;
+    }
+    // ... and the timers by ConnTimerFunc()
+    for (Timer *t : { &our_sa_timer, &their_na_timer, &calls_timer }) {
+        t->callback = ConnTimerFunc;
+        t->owner = this;
+    }
+    // the loop may receive the data by itself
+    socket_watcher.data_callback = ConnDataFunc;
+
     // create a stopped event
     stopped_event = eventfd(0, 0);
 }
 
 void DowowNetwork::Connection::DeleteSendBuffer() {
-    delete[] send_buffer;
-    send_buffer = 0;
-    send_buffer_length = 0;
-    send_buffer_offset = 0;
+    for (auto& f : send_frames) delete[] f.data;
+    send_frames.clear();
+    send_frames_bytes = 0;
+    send_offset = 0;
 }
 
 void DowowNetwork::Connection::DeleteRecvBuffer() {
@@ -235,37 +615,66 @@ void DowowNetwork::Connection::DeleteRecvBuffer() {
 }
 
 bool DowowNetwork::Connection::Receive() {
-    // receiving the request length
-    if (is_recv_length) {
-        // try to receive the request length to buffer length
-        // (effectively interchangable definitions)
-        int recv_res = recv(
-            socket_fd,
-            &recv_buffer_length,
-            sizeof(recv_buffer_length) - recv_buffer_offset,
-            0);
-
-        // check results
-        if (recv_res == -1 || recv_res == 0) {
-            // the connection is broken
-            return false;
-        } else {
-            // good, increase the offset
-            recv_buffer_offset += recv_res;
+    // the chunk is received to the stack
+    char chunk[RECV_CHUNK_MAX];
+
+    // receive
+    int recv_res = recv(
+        socket_fd,
+        chunk,
+        recv_block_size < sizeof(chunk) ? recv_block_size : sizeof(chunk),
+        0);
+
+    // nothing to receive yet (the socket is nonblocking)
+    if (recv_res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return true;
+
+    // check results
+    if (recv_res == -1 || recv_res == 0) {
+        // the connection is broken
+        return false;
+    }
+
+    return Consume(chunk, recv_res);
+}
+
+bool DowowNetwork::Connection::Consume(const char *data, uint32_t length) {
+    while (length) {
+        // paused (or the earlier bytes are held back already)
+        if (is_recv_full || !is_receiving || recv_backlog.size()) {
+            recv_backlog.append(data, length);
+            break;
+        }
+
+        // receiving the request length
+        if (is_recv_length) {
+            // bytes of the length left to receive
+            uint32_t to_copy = sizeof(recv_buffer_length) - recv_buffer_offset;
+            if (to_copy > length) to_copy = length;
+
+            // receive the request length to buffer length
+            // (effectively interchangable definitions)
+            memcpy(
+                reinterpret_cast<char*>(&recv_buffer_length) + recv_buffer_offset,
+                data,
+                to_copy);
+            data += to_copy;
+            length -= to_copy;
+            recv_buffer_offset += to_copy;
 
             // check if received the length
             if (recv_buffer_offset == sizeof(recv_buffer_length)) {
                 // get the buffer length
                 recv_buffer_length = le32toh(recv_buffer_length);
 
-                // check if too big
-                if (recv_buffer_length > recv_buffer_max_length) {
+                // check if too big or too small
+                if (recv_buffer_length > recv_buffer_max_length ||
+                    recv_buffer_length < sizeof(recv_buffer_length))
+                {
                     // the connection is broken
                     return false;
                 }
 
-                // offset for data must be set to be after the size
-                recv_buffer_offset = sizeof(recv_buffer_length);
                 // create the buffer
                 recv_buffer = new char[recv_buffer_length];
 
@@ -277,145 +686,175 @@ bool DowowNetwork::Connection::Receive() {
                 is_recv_length = false;
             }
         }
-    }
-    // receiving the request itself
-    else {
-        // bytes left to receive
-        uint32_t bytes_left =
-            recv_buffer_length - recv_buffer_offset;
-
-        // receive
-        int recv_res = recv(
-            socket_fd,
-            recv_buffer + recv_buffer_offset,
-            bytes_left < recv_block_size ? bytes_left : recv_block_size,
-            0);
-
-        // check results
-        if (recv_res == -1 || recv_res == 0) {
-            // connection is broken
-            return false;
-        } else {
-            // increase the offset
-            recv_buffer_offset += recv_res;
+        // receiving the request itself
+        else {
+            // bytes left to receive
+            uint32_t to_copy =
+                recv_buffer_length - recv_buffer_offset;
+            if (to_copy > length) to_copy = length;
+
+            memcpy(recv_buffer + recv_buffer_offset, data, to_copy);
+            data += to_copy;
+            length -= to_copy;
+            recv_buffer_offset += to_copy;
+        }
 
-            // check if received everything
-            if (recv_buffer_offset == recv_buffer_length) {
-                // try to deserialize
-                Request* req = new Request();
-                uint32_t used = req->Deserialize(recv_buffer, recv_buffer_length);
+        // check if received everything
+        if (!is_recv_length && recv_buffer_offset == recv_buffer_length) {
+            // try to deserialize
+            Request* req = new Request();
+            uint32_t used = req->Deserialize(recv_buffer, recv_buffer_length);
 
-                if (used == 0) {
-                    // fail :-(
+            if (used == 0) {
+                // fail :-(
+                delete req;
+            } else {
+                // check if keep_alive
+                if (req->GetName() == "_") {
+                    // just delete it
                     delete req;
                 } else {
-                    // check if keep_alive
-                    if (req->GetName() == "_") {
-                        // just delete it
-                        delete req;
-                    } else {
-                        // try to process using handlers
-                        if (!PassThroughHandlers(req)) {
-                            mutex_rq.lock();
-                            recv_queue.push(req);
-                            mutex_rq.unlock();
-
-                            // queue updated, notify outer code
-                            if (receive_event != -1) {
-                                Utils::WriteEventFd(receive_event, 1);
-                            }
-                        }
-                    }
+                    // handle or queue
+                    DispatchReceived(req);
                 }
-                // delete the buffer
-                DeleteRecvBuffer();
             }
+            // delete the buffer
+            DeleteRecvBuffer();
         }
     }
 
-    // update the timeout
-    Utils::SetTimerFdTimeout(
-        their_na_timer,
-        their_na_interval);
+    // postpone the timeout (cheap, the wheel isn't touched)
+    EventLoop::PostponeTimer(
+        &their_na_timer,
+        Utils::GetMonotonicMS() + their_na_interval * 1000);
 
     // good
     return true;
 }
 
+bool DowowNetwork::Connection::ConsumeBacklog() {
+    // remark:  the rest is held back again if paused meanwhile
+    std::string backlog;
+    backlog.swap(recv_backlog);
+    return Consume(backlog.data(), backlog.size());
+}
+
 bool DowowNetwork::Connection::Send() {
-    // lock the send queue
-    mutex_sq.lock();
-    // pop the send queue if the buffer is empty
-    if (!send_buffer && send_queue.size())
-        PopSendQueue();
-    // unlock the send queue
-    mutex_sq.unlock();
+    // the higher lanes overtake the frames gathered already
+    while (send_frames.size() &&
+        send_frames.size() < SEND_FRAMES_MAX &&
+        send_frames.back().priority &&
+        PopSendQueue(send_frames.back().priority - 1));
+
+    // gather the queued requests until the socket buffer is filled
+    uint32_t gather_size = send_buffer_size;
+    if (send_block_size && send_block_size < gather_size)
+        gather_size = send_block_size;
+    while (send_frames_bytes < gather_size &&
+        send_frames.size() < SEND_FRAMES_MAX &&
+        PopSendQueue());
+    // the socket buffer size is unknown
+    if (send_frames.empty()) PopSendQueue();
 
     // check if has data to send
-    if (send_buffer) {
-        // bytes left to send
-        uint32_t left_to_send =
-            send_buffer_length - send_buffer_offset;
+    if (send_frames.size()) {
+        // the unsent parts of the frames, up to the block size
+        iovec iov[SEND_FRAMES_MAX];
+        uint32_t iov_amount = 0;
+        uint32_t block_left = send_block_size ? send_block_size : UINT32_MAX;
+        for (auto& f : send_frames) {
+            if (iov_amount == SEND_FRAMES_MAX || !block_left) break;
+            uint32_t offset = iov_amount ? 0 : send_offset;
+            uint32_t length = f.length - offset;
+            if (length > block_left) length = block_left;
+            iov[iov_amount].iov_base = const_cast<char*>(f.data + offset);
+            iov[iov_amount].iov_len = length;
+            iov_amount++;
+            block_left -= length;
+        }
 
-        // write to the socket.
+        // write to the socket with a single system call.
         // MSG_NOSIGNAL to disable broken pipe signal
-        int send_res = send(
-            socket_fd,
-            send_buffer + send_buffer_offset,
-            left_to_send < send_block_size ? left_to_send : send_block_size,
-            MSG_NOSIGNAL);
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_amount;
+        ssize_t send_res = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+
+        // the socket buffer is full (the socket is nonblocking),
+        // EPOLLOUT comes once there's space
+        if (send_res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return true;
 
         // check result
         if (send_res == -1 || send_res == 0) {
             // the connection is broken
             return false;
-        } else {
-            // increase offset
-            send_buffer_offset += send_res;
-            // sent everything
-            if (send_buffer_offset == send_buffer_length) {
-                DeleteSendBuffer();
-                
-                // lock
-                MTLock(__mcd, mutex_cd);
-
-                // check if disconnecting and no data left
-                if (is_disconnecting &&
-                    !HasSomethingToSend())
-                {
-                    // let the background thread think that
-                    // the connection is dead.
-                    return false;
-                }
+        }
+
+        // delete the sent frames, the last one may be sent partially
+        uint32_t sent = send_res;
+        send_frames_bytes -= sent;
+        unsent_bytes -= sent;
+        while (sent) {
+            SendFrame& f = send_frames.front();
+            uint32_t left = f.length - send_offset;
+            if (sent < left) {
+                send_offset += sent;
+                break;
             }
+            sent -= left;
+            delete[] f.data;
+            send_frames.pop_front();
+            send_offset = 0;
+        }
+        CheckLowWatermark();
+
+        // check if disconnecting and no data left
+        if (state == ConnectionStateDraining &&
+            !HasSomethingToSend())
+        {
+            // let the event loop think that
+            // the connection is dead.
+            is_drained = true;
+            return false;
         }
     }
 
-    // update the timeout
-    Utils::SetTimerFdTimeout(
-        our_sa_timer,
-        our_sa_interval);
+    // postpone the timeout (cheap, the wheel isn't touched)
+    EventLoop::PostponeTimer(
+        &our_sa_timer,
+        Utils::GetMonotonicMS() + our_sa_interval * 1000);
 
     // success
     return true;
 }
 
-bool DowowNetwork::Connection::PopSendQueue() {
-    // Lock the send queue
-    MTLock(__msq, mutex_sq);
-
-    // check if no data in queue
-    if (!send_queue.size())
+bool DowowNetwork::Connection::PopSendQueue(uint8_t lowest) {
+    // popping from the highest priority lane, no data in queues
+    Request* req;
+    uint8_t priority = 0;
+    while (priority <= lowest && !send_queues[priority].Pop(req))
+        priority++;
+    if (priority > lowest)
         return false;
 
-    // popping
-    Request* req = send_queue.front();
-    send_queue.pop();
-
     // serializing
-    send_buffer = req->Serialize();
-    send_buffer_length = req->GetSize();
-    send_buffer_offset = 0;
+    SendFrame f;
+    f.data = req->Serialize();
+    f.length = req->GetSize();
+    f.priority = priority;
+
+    // after the frames of the same or higher lanes
+    // remark:  the partially sent one is finished first
+    auto it = send_frames.end();
+    while (it != send_frames.begin() + (send_offset ? 1 : 0) &&
+        (it - 1)->priority > priority)
+    {
+        --it;
+    }
+    send_frames.insert(it, f);
+    send_frames_bytes += f.length;
 
     // deleting the request
     delete req;
@@ -423,22 +862,20 @@ bool DowowNetwork::Connection::PopSendQueue() {
     return true;
 }
 
-void DowowNetwork::Connection::InitializeByFD(int socket_fd) {
-    // lock
-    MTLock(__mcd, mutex_cd);
-    MTLock(__mbt, mutex_bt);
+DowowNetwork::EventLoop* DowowNetwork::Connection::PickLoop() {
+    if (fixed_loop) return fixed_loop;
+    if (reactor) return reactor->GetLoop();
 
-    // do nothing if already connected
-    if (IsConnected()) return;
+    // create the own loop once, it's reused on reconnection
+    if (!own_loop) own_loop = new EventLoop(io_backend, own_loop_cpu);
+    return own_loop;
+}
 
-    // check if background thread exists
-    if (background_thread) {
-        // just detach it, nothing bad
-        // will happen, because not connected
-        background_thread->detach();
-        // free memory
-        delete background_thread;
-    }
+void DowowNetwork::Connection::InitializeByFD(int socket_fd, EventLoop *serving_loop) {
+    // do nothing if already connected
+    uint8_t stopped = ConnectionStateStopped;
+    if (!state.compare_exchange_strong(stopped, ConnectionStateConnecting))
+        return;
 
     // get the type
     int socket_domain;
@@ -457,29 +894,35 @@ void DowowNetwork::Connection::InitializeByFD(int socket_fd) {
         case AF_INET: socket_type = SocketTypeTcp; break;
         // the type is not supported
         default:
+            state = ConnectionStateStopped;
             return;
     }
 
+    // get the send buffer size the frames are gathered up to
+    int buffer_size = 0;
+    len = sizeof(buffer_size);
+    getsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, &len);
+    send_buffer_size = buffer_size > 0 ? buffer_size : 0;
+
     // reset the stopped event
     Utils::ReadEventFd(stopped_event, 0);
 
-    // initialize the events
-    push_event = eventfd(0, 0);
-    to_stop_event = eventfd(0, 0);
-
-    // create the timers for keep-alive mechanism
-    our_sa_timer = timerfd_create(CLOCK_MONOTONIC, 0);
-    their_na_timer = timerfd_create(CLOCK_MONOTONIC, 0);
-
-    // start the timers
-    Utils::SetTimerFdTimeout(our_sa_timer, our_sa_interval);
-    Utils::SetTimerFdTimeout(their_na_timer, their_na_interval);
-
-    // not disconnecting
-    is_disconnecting = false;
+    // not disconnected yet
+    is_drained = false;
+    // nothing to wake up for yet
+    is_push_pending = false;
+    // the receive queue is cleared below
+    is_recv_full = false;
+    // the send queue is empty
+    is_send_high = false;
 
     // reset IDs
-    free_request_id = is_even_request_parts ? 2 : 1;
+    free_request_id.store(is_even_request_parts ? 2 : 1);
+
+    // accept the calls again
+    mutex_pc.lock();
+    is_calls_closed = false;
+    mutex_pc.unlock();
 
     // cleanup receive queue
     mutex_rq.lock();
@@ -492,33 +935,302 @@ void DowowNetwork::Connection::InitializeByFD(int socket_fd) {
     // assign the socket
     this->socket_fd = socket_fd;
 
-    // create the background thread
-    background_thread = new std::thread(ConnThreadFunc, this);
+    // pick the event loop (unless picked by the caller)
+    loop = serving_loop ? serving_loop : PickLoop();
+    loop->Attach();
+    ApplyBusyPoll();
+    ApplyNotSentLowat();
+
+    // start monitoring
+    // remark:  the callbacks may be invoked from now on,
+    //          everything they need is set up already
+    bool was_receiving = is_receiving;
+    loop->Add(&socket_watcher, socket_fd, was_receiving ? EPOLLIN : 0);
+
+    // start the timers for keep-alive mechanism
+    uint64_t now = Utils::GetMonotonicMS();
+    loop->StartTimer(&our_sa_timer, now + our_sa_interval * 1000);
+    loop->StartTimer(&their_na_timer, now + their_na_interval * 1000);
+
+    // connected
+    state = ConnectionStateConnected;
+
+    // SetReceiving() might have missed the loop meanwhile
+    if (is_receiving != was_receiving) {
+        IncreaseRefs();
+        WakeLoop();
+        DecreaseRefs();
+    }
 }
 
 void DowowNetwork::Connection::SetEvenRequestIdsPart(bool state) {
-    // lock
-    MTLock(__mfri, mutex_fri);
-    
     // set the state
     is_even_request_parts = state;
 
     // the id
-    if ((is_even_request_parts && (free_request_id % 2)) ||
-        (!is_even_request_parts && !(free_request_id % 2)))
-    {
-        free_request_id++;
-    }
+    uint32_t id = free_request_id.load();
+    while ((id % 2 == 0) != state &&
+           !free_request_id.compare_exchange_weak(id, id + 1));
+}
+
+DowowNetwork::Connection::Connection(
+    int socket_fd,
+    Reactor *reactor,
+    uint8_t io_backend,
+    int32_t cpu,
+    bool is_receiving) : Connection()
+{
+    this->reactor = reactor;
+    this->io_backend = io_backend;
+    own_loop_cpu = cpu;
+    HoldStart(is_receiving);
+    InitializeByFD(socket_fd);
+    SetEvenRequestIdsPart(true);
 }
 
-DowowNetwork::Connection::Connection(int socket_fd) : Connection() {
+DowowNetwork::Connection::Connection(int socket_fd, EventLoop *loop, bool is_receiving) : Connection() {
+    fixed_loop = loop;
+    HoldStart(is_receiving);
     InitializeByFD(socket_fd);
     SetEvenRequestIdsPart(true);
 }
 
+void DowowNetwork::Connection::SetReactor(Reactor *reactor) {
+    this->reactor = reactor;
+}
+
+DowowNetwork::Reactor* DowowNetwork::Connection::GetReactor() {
+    return reactor;
+}
+
+void DowowNetwork::Connection::SetIoBackend(uint8_t io_backend) {
+    this->io_backend = io_backend;
+}
+
+void DowowNetwork::Connection::SetHandlerPool(HandlerPool *pool) {
+    MTLock(__mhq, mutex_hq);
+    handler_pool = pool;
+}
+
+DowowNetwork::HandlerPool* DowowNetwork::Connection::GetHandlerPool() {
+    return handler_pool;
+}
+
+uint8_t DowowNetwork::Connection::GetIoBackend() {
+    return loop ? loop->GetBackend() : io_backend;
+}
+
+void DowowNetwork::Connection::SetLoopCpu(int32_t cpu) {
+    own_loop_cpu = cpu;
+}
+
+int32_t DowowNetwork::Connection::GetLoopCpu() {
+    return loop ? loop->GetCpu() : own_loop_cpu;
+}
+
+void DowowNetwork::Connection::ApplyBusyPoll() {
+    // the shared loops are configured by their owners
+    if (loop == own_loop) own_loop->SetBusyPoll(busy_poll_us);
+
+    if (busy_poll_us && socket_type == SocketTypeTcp) {
+        int us = busy_poll_us;
+        setsockopt(socket_fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us));
+    }
+}
+
+void DowowNetwork::Connection::SetBusyPoll(uint32_t us) {
+    busy_poll_us = us;
+
+    // not finalized while referenced
+    IncreaseRefs();
+    if (IsPolling()) ApplyBusyPoll();
+    DecreaseRefs();
+}
+
+uint32_t DowowNetwork::Connection::GetBusyPoll() {
+    return busy_poll_us;
+}
+
+void DowowNetwork::Connection::ApplyNotSentLowat() {
+    // bound the kernel buffering too
+    // remark:  the kernel default is kept if unlimited
+    if (send_high_watermark && socket_type == SocketTypeTcp) {
+        int lowat = send_low_watermark;
+        setsockopt(socket_fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+    }
+}
+
+bool DowowNetwork::Connection::ReserveSendSpace() {
+    // unlimited or not overflowed
+    uint32_t high = send_high_watermark;
+    if (!high || unsent_bytes < high) return true;
+
+    // the loop thread drains the queue, so it never waits
+    if (overflow_mode != OverflowModeBlock || loop->IsInLoopThread())
+        return false;
+
+    // the loop thread reports the drained queue only if overflowed
+    CheckHighWatermark();
+
+    // wait for the room, the disconnection or the new settings
+    std::unique_lock<std::mutex> __mss(mutex_ss);
+    send_space_cv.wait(__mss, [this]() {
+        return
+            !send_high_watermark ||
+            unsent_bytes <= send_low_watermark ||
+            overflow_mode != OverflowModeBlock ||
+            state != ConnectionStateConnected;
+    });
+
+    return
+        state == ConnectionStateConnected &&
+        overflow_mode == OverflowModeBlock;
+}
+
+void DowowNetwork::Connection::CheckHighWatermark() {
+    uint32_t high = send_high_watermark;
+    uint32_t unsent = unsent_bytes;
+    if (!high || unsent < high) return;
+
+    // report once per overflow
+    if (is_send_high.exchange(true)) return;
+    if (high_watermark_handler) (*high_watermark_handler)(this, unsent);
+
+    // the queue might be drained meanwhile
+    WakeLoop();
+}
+
+void DowowNetwork::Connection::CheckLowWatermark() {
+    // not overflowed
+    if (!is_send_high) return;
+    uint32_t unsent = unsent_bytes;
+    if (unsent > send_low_watermark) return;
+
+    // report once per overflow
+    if (!is_send_high.exchange(false)) return;
+    if (low_watermark_handler) (*low_watermark_handler)(this, unsent);
+
+    NotifySendSpace();
+}
+
+void DowowNetwork::Connection::NotifySendSpace() {
+    // remark:  locked so the waiter can't miss it between
+    //          the check and the wait
+    mutex_ss.lock();
+    mutex_ss.unlock();
+    send_space_cv.notify_all();
+}
+
+void DowowNetwork::Connection::SetSendWatermarks(uint32_t high, uint32_t low) {
+    send_low_watermark = low < high ? low : high;
+    send_high_watermark = high;
+
+    // not finalized while referenced
+    IncreaseRefs();
+    if (state == ConnectionStateConnected) {
+        ApplyNotSentLowat();
+        // the blocked callers might fit now
+        WakeLoop();
+        NotifySendSpace();
+    }
+    DecreaseRefs();
+}
+
+uint32_t DowowNetwork::Connection::GetSendHighWatermark() {
+    return send_high_watermark;
+}
+
+uint32_t DowowNetwork::Connection::GetSendLowWatermark() {
+    return send_low_watermark;
+}
+
+void DowowNetwork::Connection::SetOverflowMode(uint8_t mode) {
+    overflow_mode = mode;
+    // the blocked callers fail or drop now
+    NotifySendSpace();
+}
+
+uint8_t DowowNetwork::Connection::GetOverflowMode() {
+    return overflow_mode;
+}
+
+uint64_t DowowNetwork::Connection::GetOverflowsAmount() {
+    return overflows_amount;
+}
+
+void DowowNetwork::Connection::SetHighWatermarkHandler(WatermarkHandler h) {
+    high_watermark_handler = h;
+}
+
+void DowowNetwork::Connection::SetLowWatermarkHandler(WatermarkHandler h) {
+    low_watermark_handler = h;
+}
+
+DowowNetwork::EventLoop* DowowNetwork::Connection::GetLoop() {
+    return loop;
+}
+
+void DowowNetwork::Connection::ApplyReceiving(bool is_receiving) {
+    this->is_receiving = is_receiving;
+
+    // not finalized while referenced
+    IncreaseRefs();
+    if (state == ConnectionStateConnected) WakeLoop();
+    DecreaseRefs();
+}
+
+void DowowNetwork::Connection::SetReceiving(bool is_receiving) {
+    ApplyReceiving(is_receiving);
+
+    // release the connection created not receiving
+    if (is_start_held.exchange(false))
+        DecreaseRefs();
+}
+
+void DowowNetwork::Connection::StartReceiving() {
+    // SetReceiving() is called since the creation
+    if (!is_start_held.exchange(false)) return;
+
+    ApplyReceiving(true);
+    DecreaseRefs();
+}
+
+bool DowowNetwork::Connection::IsReceiving() {
+    return is_receiving;
+}
+
+void DowowNetwork::Connection::SetRecvQueueLimit(uint32_t limit) {
+    MTLock(__mrq, mutex_rq);
+    recv_queue_limit = limit;
+
+    // the reading might be paused by the old limit
+    ResumeIfPulled();
+}
+
+uint32_t DowowNetwork::Connection::GetRecvQueueLimit() {
+    return recv_queue_limit;
+}
+
+uint32_t DowowNetwork::Connection::GetUnsentBytes() {
+    return unsent_bytes;
+}
+
+uint32_t DowowNetwork::Connection::GetPendingCallsAmount() {
+    MTLock(__mpc, mutex_pc);
+    return pending_calls.size();
+}
+
 void DowowNetwork::Connection::SetOurSaInterval(time_t interval) {
     our_sa_interval = interval < 1 ? 1 : interval;
-    Utils::SetTimerFdTimeout(our_sa_timer, our_sa_interval);
+
+    // not finalized while referenced
+    IncreaseRefs();
+    if (IsPolling()) {
+        loop->StartTimer(
+            &our_sa_timer,
+            Utils::GetMonotonicMS() + our_sa_interval * 1000);
+    }
+    DecreaseRefs();
 }
 
 time_t DowowNetwork::Connection::GetOurSaInterval() {
@@ -527,30 +1239,63 @@ time_t DowowNetwork::Connection::GetOurSaInterval() {
 
 void DowowNetwork::Connection::SetTheirNaIntervalLimit(time_t interval) {
     their_na_interval = interval < 1 ? 1 : interval;
-    Utils::SetTimerFdTimeout(their_na_timer, their_na_interval);
+
+    // not finalized while referenced
+    IncreaseRefs();
+    if (IsPolling()) {
+        loop->StartTimer(
+            &their_na_timer,
+            Utils::GetMonotonicMS() + their_na_interval * 1000);
+    }
+    DecreaseRefs();
 }
 
 time_t DowowNetwork::Connection::GetTheirNaIntervalLimit() {
     return their_na_interval;
 }
 
-DowowNetwork::Request* DowowNetwork::Connection::Push(Request* req, bool must_copy, int timeout, bool change_request_id) {
-    {
-        // lock
-        MTLock(__mcd, mutex_cd);
+bool DowowNetwork::Connection::Enqueue(
+    Request* req,
+    bool must_copy,
+    bool change_request_id,
+    PendingCall *call,
+    int timeout,
+    uint8_t priority,
+    bool is_bounded)
+{
+    // not finalized while referenced, so the loop can be notified
+    IncreaseRefs();
+
+    // not connected (the loop may not be picked yet) or disconnecting
+    if (state != ConnectionStateConnected) {
+        // delete the data if it is not copied
+        if (!must_copy)
+            delete req;
+        DecreaseRefs();
+        return false;
+    }
 
-        // not connected or disconnecting
-        if (!IsConnected() || IsDisconnecting()) {
-            // delete the data if it is not copied
-            if (!must_copy)
-                delete req;
-            return 0;
+    // the send queue is overflowed
+    if (is_bounded && !ReserveSendSpace()) {
+        overflows_amount++;
+        // delete the data if it is not copied
+        if (!must_copy)
+            delete req;
+        DecreaseRefs();
+
+        // refused
+        if (overflow_mode != OverflowModeDrop) return false;
+
+        // dropped: the response won't come
+        if (call && call->callback) {
+            call->callback(this, 0);
+            delete call;
+        } else if (call) {
+            call->is_done = true;
         }
+        return true;
     }
 
-    // lock the send queue
-    MTLock(__msq, mutex_sq);
-
     // copy the request if needed
     if (must_copy) {
         Request* copy = new Request();
@@ -562,135 +1307,206 @@ DowowNetwork::Request* DowowNetwork::Connection::Push(Request* req, bool must_co
     uint32_t req_id = req->GetId();
     // must change the request id
     if (change_request_id) {
-        // lock the free request id
-        MTLock(__mfri, mutex_fri);
-        // store the request id
-        req_id = free_request_id;
+        // take the id, increase the free request ID by 2,
+        // as each side has a half of all IDs
+        req_id = free_request_id.fetch_add(2);
         // set the id
         req->SetId(req_id);
-        // increase the free request ID by 2, as each side has a half of all IDs
-        free_request_id += 2;
     }
 
-    // push to queue
-    send_queue.push(req);
+    // register the call before sending,
+    // so the response can't be missed
+    if (call && !AddPendingCall(req_id, call, timeout)) {
+        // the connection is stopped meanwhile
+        delete req;
+        DecreaseRefs();
+        return false;
+    }
+
+    // push to queue (lock-free)
+    unsent_bytes += req->GetSize();
+    if (priority >= SendPrioritiesAmount) priority = SendPriorityBulk;
+    send_queues[priority].Push(req);
+    if (is_bounded) CheckHighWatermark();
+
+    // wake the loop thread up, unless it's going to send anyway
+    WakeLoop();
 
-    // notify the thread
-    Utils::WriteEventFd(push_event, 1);
+    DecreaseRefs();
+    return true;
+}
+
+DowowNetwork::Request* DowowNetwork::Connection::Push(Request* req, bool must_copy, int timeout, bool change_request_id, uint8_t priority) {
+    // not waiting for the response
+    if (!timeout) {
+        Enqueue(req, must_copy, change_request_id, 0, 0, priority);
+        return 0;
+    }
 
-    return 0;
+    // the call waiting for the response
+    PendingCall call;
+    if (!Enqueue(req, must_copy, change_request_id, &call, timeout, priority))
+        return 0;
+
+    return WaitPendingCall(&call, timeout);
 }
 
-DowowNetwork::Request* DowowNetwork::Connection::Push(const Request& req, int timeout, bool change_request_id) {
+DowowNetwork::Request* DowowNetwork::Connection::Push(const Request& req, int timeout, bool change_request_id, uint8_t priority) {
     // copy
     Request *copy = new Request();
     copy->CopyFrom(&req);
     // reuse code
-    return Push(copy, false, timeout, change_request_id);
+    return Push(copy, false, timeout, change_request_id, priority);
+}
+
+bool DowowNetwork::Connection::PushAsync(const Request& req, int timeout, ResponseCallback callback, bool change_request_id, uint8_t priority) {
+    // the call is deleted once completed
+    PendingCall *call = new PendingCall();
+    call->callback = callback;
+
+    // the copy is taken by the send queue
+    Request *copy = new Request();
+    copy->CopyFrom(&req);
+
+    if (!Enqueue(copy, false, change_request_id, call, timeout, priority)) {
+        // not connected
+        delete call;
+        callback(this, 0);
+        return false;
+    }
+
+    return true;
+}
+
+std::future<DowowNetwork::Request*> DowowNetwork::Connection::PushFuture(const Request& req, int timeout, bool change_request_id, uint8_t priority) {
+    // shared with the callback
+    auto promise = std::make_shared<std::promise<Request*>>();
+    std::future<Request*> result = promise->get_future();
+
+    PushAsync(
+        req,
+        timeout,
+        [promise](Connection *c, Request *r) { promise->set_value(r); },
+        change_request_id,
+        priority);
+
+    return result;
 }
 
 DowowNetwork::Request* DowowNetwork::Connection::Pull(int timeout) {
+    // reuse code
+    Request *req = 0;
+    PullMany(&req, 1, timeout);
+    return req;
+}
+
+uint32_t DowowNetwork::Connection::PullMany(Request **requests, uint32_t max, int timeout) {
     // not checking if connected, because the pulling
     // may be needed after the disconnection
+    if (!max) return 0;
 
     // lock the receive queue
-    mutex_rq.lock();
-
-    // check if has elements
-    if (recv_queue.size()) {
-        // pop
-        Request *req = recv_queue.front();
-        recv_queue.pop();
-
-        // unlock
-        mutex_rq.unlock();
-        return req;
+    MTLock(__mrq, mutex_rq);
+
+    // wait for a request or the receive to finish
+    if (!recv_queue.size() && timeout) {
+        pull_waiters++;
+        uint32_t wakeups = receive_wakeups;
+        auto is_woken = [this, wakeups]() {
+            return recv_queue.size() || receive_wakeups != wakeups;
+        };
+        if (timeout < 0) {
+            receive_cv.wait(mutex_rq, is_woken);
+        } else {
+            receive_cv.wait_for(
+                mutex_rq,
+                std::chrono::milliseconds(timeout),
+                is_woken);
+        }
+        pull_waiters--;
     }
 
-    // no timeout
-    if (!timeout) {
-        mutex_rq.unlock();
-        return 0;
+    // take the batch
+    uint32_t amount = 0;
+    while (amount < max && recv_queue.size()) {
+        requests[amount++] = recv_queue.front();
+        recv_queue.pop();
     }
 
-    // someone is already waiting for Pull, quit
-    if (receive_event != -1) {
-        mutex_rq.unlock();
-        return 0;
-    }
+    // the rest is for the other waiters
+    if (recv_queue.size() && pull_waiters) receive_cv.notify_one();
 
-    // set up receive event
-    receive_event = eventfd(0, 0);
+    // there might be room now
+    ResumeIfPulled();
 
-    // set up pollfds
-    pollfd pollfds { receive_event, POLLIN, 0 };
+    return amount;
+}
 
-    // unlock
-    mutex_rq.unlock();
+void DowowNetwork::Connection::PullAsync(ResponseCallback callback) {
+    // not checking if connected until the queue is empty,
+    // because the pulling may be needed after the disconnection
+    mutex_rq.lock();
 
-    // poll
-    poll(&pollfds, 1, timeout);
+    // the request is already here
+    if (recv_queue.size()) {
+        Request *req = recv_queue.front();
+        recv_queue.pop();
+        ResumeIfPulled();
+        mutex_rq.unlock();
 
-    // lock
-    mutex_rq.lock();
+        callback(this, req);
+        return;
+    }
 
-    // get the result
-    Request *res = Pull(0);
+    // nothing will be received
+    if (!IsConnected() || IsDisconnecting()) {
+        mutex_rq.unlock();
 
-    // close the eventfd
-    close(receive_event);
-    receive_event = -1;
+        callback(this, 0);
+        return;
+    }
 
-    // unlock
+    // wait for the next one
+    pull_callbacks.push(callback);
     mutex_rq.unlock();
-
-    return res;
 }
 
 uint32_t DowowNetwork::Connection::GetRefs() {
-    MTLock(__mra, mutex_ra);
-    return refs_amount;
+    return refs_amount & ~REFS_AWAITING_RELEASE;
 }
 
 void DowowNetwork::Connection::IncreaseRefs() {
-    mutex_ra.lock();
     refs_amount++;
-    mutex_ra.unlock();
 }
 
 void DowowNetwork::Connection::DecreaseRefs() {
-    mutex_ra.lock();
-    refs_amount--;
-    // the background thread awaits loneliness ;-(
-    if (not_needed_event != -1)
-        Utils::WriteEventFd(not_needed_event, 1);
-    mutex_ra.unlock();
+    // the last one
+    if (refs_amount-- == (REFS_AWAITING_RELEASE | 1))
+        FinalizeIfReleased();
 }
 
 void DowowNetwork::Connection::Disconnect(bool forced, bool wait_for_join) {
-    mutex_cd.lock();
     // check if not connected
-    if (!IsConnected()) {
-        mutex_cd.unlock();
-        return;
-    }
+    if (!IsConnected()) return;
+
+    // not finalized while referenced, so the loop can be notified
+    IncreaseRefs();
 
     // check if requesting forced disconnection
     if (forced) {
         // forced
-        Utils::WriteEventFd(to_stop_event, 1);
-    } else if (!is_disconnecting) {
-        // mark for disconnection
-        is_disconnecting = true;
-        // graceful
-        Request *dummy = new Request("_");
-        // push a dummy request so that the
-        // thread will call Send() and
-        // eventually stop
-        Push(dummy, false, 0, false);
+        if (IsPolling()) loop->Notify(&to_stop_watcher);
+    } else {
+        // graceful: the loop thread sends the rest and stops
+        uint8_t connected = ConnectionStateConnected;
+        if (state.compare_exchange_strong(connected, ConnectionStateDraining)) {
+            loop->Notify(&push_watcher);
+            // nothing will be pushed anymore
+            NotifySendSpace();
+        }
     }
 
-    mutex_cd.unlock();
+    DecreaseRefs();
 
     // waiting for join
     if (wait_for_join)
@@ -698,17 +1514,31 @@ void DowowNetwork::Connection::Disconnect(bool forced, bool wait_for_join) {
 }
 
 bool DowowNetwork::Connection::IsConnected() {
-    // connected if we can define the socket type
-    return GetType() != SocketTypeUndefined;
+    uint8_t s = state;
+    return
+        s == ConnectionStateConnected ||
+        s == ConnectionStateDraining ||
+        s == ConnectionStateStopping;
 }
 
 bool DowowNetwork::Connection::IsDisconnecting() {
-    // disconnecting when still connected but the flag is set
-    return is_disconnecting && IsConnected();
+    uint8_t s = state;
+    return
+        s == ConnectionStateDraining ||
+        s == ConnectionStateStopping;
+}
+
+uint8_t DowowNetwork::Connection::GetState() {
+    return state;
+}
+
+bool DowowNetwork::Connection::IsDrained() {
+    return is_drained;
 }
 
 uint8_t DowowNetwork::Connection::GetType() {
-    return socket_type;
+    // the type is valid only while connected
+    return IsConnected() ? socket_type : SocketTypeUndefined;
 }
 
 int DowowNetwork::Connection::GetStoppedEvent() {
@@ -720,14 +1550,18 @@ bool DowowNetwork::Connection::WaitForStop(int timeout) {
 }
 
 void DowowNetwork::Connection::SetHandlerDefault(RequestHandler h) {
+    MTLock(__mh, mutex_h);
     handler_default = h;
 }
 
 DowowNetwork::RequestHandler DowowNetwork::Connection::GetHandlerDefault() {
+    MTLock(__mh, mutex_h);
     return handler_default;
 }
 
 void DowowNetwork::Connection::SetHandlerNamed(std::string name, RequestHandler h) {
+    MTLock(__mh, mutex_h);
+
     // must delete and is set
     if (h == 0) {
         auto it = handlers_named.find(name);
@@ -742,6 +1576,8 @@ void DowowNetwork::Connection::SetHandlerNamed(std::string name, RequestHandler
 }
 
 DowowNetwork::RequestHandler DowowNetwork::Connection::GetHandlerNamed(std::string name) {
+    MTLock(__mh, mutex_h);
+
     auto it = handlers_named.find(name);
     // is not set
     if (it == handlers_named.end()) return 0;
@@ -751,8 +1587,7 @@ DowowNetwork::RequestHandler DowowNetwork::Connection::GetHandlerNamed(std::stri
 }
 
 void DowowNetwork::Connection::SetSendBlockSize(uint32_t bs) {
-    // not less than 1
-    if (bs < 1) bs = 1;
+    // 0 for no cap
     send_block_size = bs;
 }
 
@@ -787,13 +1622,13 @@ DowowNetwork::Connection::~Connection() {
     // and wait for stop.
     Disconnect(true, true);
 
-    // lock the thread
-    MTLock(__mbt, mutex_bt);
+    // stop the own loop if it exists
+    delete own_loop;
 
-    // join the background thread if it exists
-    if (background_thread) {
-        background_thread->join();
-        delete background_thread;
+    // nobody is going to pull the rest
+    while (recv_queue.size()) {
+        delete recv_queue.front();
+        recv_queue.pop();
     }
 
     // close the stopped eventfd
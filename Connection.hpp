@@ -8,10 +8,13 @@
 #define __DOWOW_NETWORK__CONNECTION_H_
 
 #include <queue>
+#include <deque>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <map>
+#include <functional>
+#include <future>
 
 #ifdef DUMP_CONNECTIONS
 #include <fstream>
@@ -19,12 +22,22 @@
 #include <ctime>
 #endif
 
+#include <atomic>
 #include <mutex>
 #include <thread>
+#include <condition_variable>
+#include <unordered_map>
 
 #include "Utils.hpp"
 #include "SocketType.hpp"
+#include "ConnectionState.hpp"
+#include "OverflowMode.hpp"
+#include "SendPriority.hpp"
 #include "Request.hpp"
+#include "EventLoop.hpp"
+#include "Reactor.hpp"
+#include "HandlerPool.hpp"
+#include "MpscQueue.hpp"
 
 namespace DowowNetwork {
     // Predeclare the connection for typedef
@@ -37,47 +50,117 @@ namespace DowowNetwork {
     */
     typedef void (*RequestHandler)(Connection* c, Request* r);
 
+    //! Asynchronous call completion callback prototype.
+    /*!
+        \param c Connection the call was made on
+        \param r the response [YOURS], null-pointer if the call is
+               timed out or the connection is lost
+    */
+    typedef std::function<void(Connection* c, Request* r)> ResponseCallback;
+
+    //! Send queue watermark handler prototype.
+    /*!
+        \param c Connection which send queue crossed the watermark
+        \param unsent_bytes the amount of bytes not sent yet
+    */
+    typedef void (*WatermarkHandler)(Connection* c, uint32_t unsent_bytes);
+
     //! A connection between two endpoints.
     class Connection {
     private:
-        //! mutex for send queue
-        std::recursive_mutex mutex_sq;
+        //! A Push() waiting for the response.
+        struct PendingCall {
+            //! The ID of the sent request.
+            uint32_t id = 0;
+            //! The response, null-pointer if timed out or disconnected.
+            Request *response = 0;
+            //! Is the call completed?
+            bool is_done = false;
+            //! Notified when the call is completed (blocking calls).
+            std::condition_variable cv;
+            //! Called when the call is completed (asynchronous calls).
+            ResponseCallback callback;
+            //! Is the call in call_deadlines?
+            bool has_deadline = false;
+            //! The position in call_deadlines.
+            std::multimap<uint64_t, uint32_t>::iterator deadline_it;
+        };
+
+        //! A serialized request being sent.
+        struct SendFrame {
+            //! The serialized request.
+            const char *data;
+            //! The length of the data.
+            uint32_t length;
+            //! The lane the request is popped from, see SendPriority.
+            uint8_t priority;
+        };
+
         //! mutex for receive queue
         std::recursive_mutex mutex_rq;
-        //! mutex for free request id
-        std::recursive_mutex mutex_fri;
-        //! mutex for refs amount
-        std::recursive_mutex mutex_ra;
-        //! mutex for 'connected' and 'disconnecting' states
-        std::recursive_mutex mutex_cd;
-        //! mutex for background thread pointer
-        std::recursive_mutex mutex_bt;
+        //! mutex for handler queue
+        std::recursive_mutex mutex_hq;
+        //! mutex for pending calls
+        std::mutex mutex_pc;
+        //! mutex for the handlers
+        //! (the loop and the pool threads look them up)
+        std::mutex mutex_h;
 
         //! The ID of the free request.
-        uint32_t free_request_id = 1;
+        std::atomic<uint32_t> free_request_id;
         //! Use even or odd request ids?
         bool is_even_request_parts = false;
-        //! Is disconnection in progress?
-        bool is_disconnecting = false;
+        //! The lifecycle stage, see ConnectionState.
+        std::atomic<uint8_t> state;
+        //! Has the graceful disconnection sent everything?
+        std::atomic<bool> is_drained;
 
         //! The socket file descriptor.
         int socket_fd = -1;
 
         //! The socket type.
-        //! SocketTypeUndefined is interpreted as 'not connected'
+        //! Valid only while connected.
         uint8_t socket_type = SocketTypeUndefined;
 
         //! The maximum amount of bytes we will attempt to send
-        //! at a time.
-        uint32_t send_block_size = 1024;
-        //! The send buffer.
-        const char* send_buffer = 0;
-        //! The length of the send buffer.
-        uint32_t send_buffer_length = 0;
-        //! The offset of the send buffer.
-        uint32_t send_buffer_offset = 0;
-        //! The queue of requests to send.
-        std::queue<Request*> send_queue;
+        //! at a time, 0 if unlimited.
+        uint32_t send_block_size = 0;
+        //! The socket send buffer size (SO_SNDBUF).
+        //! The frames are gathered until it's filled.
+        uint32_t send_buffer_size = 0;
+        //! The serialized requests being sent, by priority.
+        /*! The first one may be sent partially, the rest are ordered
+         *  by the lane, then by the pop order.
+         */
+        std::deque<SendFrame> send_frames;
+        //! The amount of bytes of send_frames not sent yet.
+        uint32_t send_frames_bytes = 0;
+        //! The amount of bytes of the first frame sent already.
+        uint32_t send_offset = 0;
+        //! The queues of requests to send by SendPriority.
+        //! Pushed by any threads, popped by the event loop thread.
+        MpscQueue<Request*> send_queues[SendPrioritiesAmount];
+        //! The amount of bytes pushed and not sent yet.
+        std::atomic<uint32_t> unsent_bytes;
+        //! The unsent bytes Push() overflows at, 0 if unlimited.
+        std::atomic<uint32_t> send_high_watermark;
+        //! The unsent bytes the overflowed queue must be drained to.
+        std::atomic<uint32_t> send_low_watermark;
+        //! What Push() does on overflow, see OverflowMode.
+        std::atomic<uint8_t> overflow_mode;
+        //! Is above the high watermark (not drained to the low one yet)?
+        std::atomic<bool> is_send_high;
+        //! Amount of the requests refused or dropped on overflow.
+        std::atomic<uint64_t> overflows_amount;
+        //! mutex for the Push() callers blocked on overflow
+        std::mutex mutex_ss;
+        //! Notified when the send queue is drained to the low
+        //! watermark or the connection is disconnecting.
+        std::condition_variable send_space_cv;
+        //! Called when the send queue gets to the high watermark.
+        WatermarkHandler high_watermark_handler = 0;
+        //! Called when the send queue is drained to the low watermark.
+        WatermarkHandler low_watermark_handler = 0;
 
         //! The maximum amount of bytes we will attempt to receive
         //! at a time.
@@ -94,8 +177,23 @@ namespace DowowNetwork {
         uint32_t recv_buffer_offset = 0;
         //! The queue of the received requests.
         std::queue<Request*> recv_queue;
+        //! The PullAsync() callers waiting for the requests.
+        std::queue<ResponseCallback> pull_callbacks;
         //! Is receiving the request length right now?
         bool is_recv_length = true;
+        //! Is the socket read? See SetReceiving().
+        std::atomic<bool> is_receiving;
+        //! Is referenced until it starts receiving?
+        std::atomic<bool> is_start_held;
+        //! The receive queue length the reading is paused at, 0 if unlimited.
+        std::atomic<uint32_t> recv_queue_limit;
+        //! Is the reading paused until the receive queue is pulled?
+        std::atomic<bool> is_recv_full;
+        //! The bytes read while paused, parsed once resumed.
+        /*! The loop may have read more than wanted before the pause
+         *  takes effect (a whole chunk, a receive in flight).
+         */
+        std::string recv_backlog;
 
         //! Session data.
         void* session_data = 0;
@@ -105,20 +203,38 @@ namespace DowowNetwork {
         //! The map of the pointers to the named request handlers.
         std::map<std::string, RequestHandler> handlers_named;
 
-        //! Push() event
-        int push_event = -1;
-        //! 'to_stop' event
-        int to_stop_event = -1;
+        //! The pool running the handlers.
+        //! Null-pointer to run them in the event loop thread.
+        HandlerPool *handler_pool = 0;
+        //! The requests waiting for the handlers (in the pool).
+        std::queue<Request*> handler_queue;
+        //! Is RunHandlers() posted to the pool?
+        bool is_handler_scheduled = false;
+
+        //! The calls waiting for the responses by the request IDs.
+        std::unordered_map<uint32_t, PendingCall*> pending_calls;
+        //! Are the new calls refused (not connected or stopping)?
+        bool is_calls_closed = true;
+        //! The asynchronous calls IDs by their deadlines
+        //! (Utils::GetMonotonicMS()).
+        std::multimap<uint64_t, uint32_t> call_deadlines;
+
         //! 'stopped' event
         int stopped_event = -1;
-        //! receive event
-        int receive_event = -1;
-        //! 'not_needed' event
-        int not_needed_event = -1;
+        //! Is the push watcher notified and not invoked yet?
+        std::atomic<bool> is_push_pending;
+        //! Pull() waits on it for the receive queue updates.
+        std::condition_variable_any receive_cv;
+        //! Amount of threads waiting in Pull() and PullMany().
+        uint32_t pull_waiters = 0;
+        //! Incremented when the receive is finished.
+        uint32_t receive_wakeups = 0;
         //! our still-alive timer
-        int our_sa_timer = -1;
+        Timer our_sa_timer;
         //! their not-alive timer
-        int their_na_timer = -1;
+        Timer their_na_timer;
+        //! asynchronous calls timer
+        Timer calls_timer;
 
         //! Our keep_alive interval
         time_t our_sa_interval = 10;
@@ -126,20 +242,89 @@ namespace DowowNetwork {
         time_t their_na_interval = 60;
 
         //! Amount of links to this connection outside the library.
-        uint32_t refs_amount = 0;
-
-        //! Background thread.
-        std::thread *background_thread = 0;
-
-        //! Polling thread function.
+        //! The high bit is set while the stopped connection is
+        //! waiting for the refs to be released.
+        std::atomic<uint32_t> refs_amount;
+
+        //! The reactor to take the event loop from.
+        //! Null-pointer for the own event loop.
+        Reactor *reactor = 0;
+        //! The event loop serving the connection.
+        EventLoop *loop = 0;
+        //! The own event loop, used if no reactor is set.
+        EventLoop *own_loop = 0;
+        //! The loop set by the creator, overrides the reactor.
+        EventLoop *fixed_loop = 0;
+        //! The backend of the own event loop.
+        uint8_t io_backend = IoBackendEpoll;
+        //! The CPU of the own event loop, negative if floating.
+        int32_t own_loop_cpu = -1;
+        //! The busy-poll budget (microseconds), 0 if disabled.
+        uint32_t busy_poll_us = 0;
+
+        //! The socket watcher.
+        Watcher socket_watcher;
+        //! 'to_stop' watcher, notified by Disconnect().
+        Watcher to_stop_watcher;
+        //! Push() watcher, notified by Push().
+        Watcher push_watcher;
+
+        //! Event handling function.
+        /*!
+         * This function is called in the event loop thread
+         * and handles I/O and events.
+         */
+        static void ConnEventFunc(Watcher *w, uint32_t events);
+        //! Received data handling function (io_uring backend).
+        static void ConnDataFunc(Watcher *w, const char *data, int32_t length);
+        //! Timer handling function.
         /*!
-         * This function is running in background and
-         * handling I/O and events.
+         * This function is called in the event loop thread
+         * when the keep-alive or the calls deadline comes.
          */
-        static void ConnThreadFunc(Connection* conn);
+        static void ConnTimerFunc(Timer *t);
+
+        //! Update the socket events we are interested in.
+        //! \warning Must be called from the event loop thread.
+        void UpdateSocketEvents();
+        //! Check if the watchers and the timers are in the loop.
+        bool IsPolling();
+        //! Stop monitoring the descriptors and schedule Finalize().
+        //! Does nothing if already stopped.
+        //! \warning Must be called from the event loop thread.
+        void StopPolling();
+        //! Schedule Finalize() if stopped and not referenced anymore.
+        void FinalizeIfReleased();
+        //! Close the descriptors and notify about stop.
+        //! \warning Must be called from the event loop thread.
+        void Finalize();
+
+        //! Set the initial receiving flag, hold the start if not receiving.
+        void HoldStart(bool is_receiving);
+        //! Set the receiving flag and update the socket events.
+        void ApplyReceiving(bool is_receiving);
+        //! Make the loop thread update the socket events.
+        //! \warning The connection must be connected and referenced.
+        void WakeLoop();
+
+        //! Apply TCP_NOTSENT_LOWAT to the socket.
+        //! \warning The connection must be polling.
+        void ApplyNotSentLowat();
+        //! Wait for the room in the send queue if it's overflowed.
+        /*! \return false if the Request must not be pushed
+         *          (see OverflowMode). */
+        bool ReserveSendSpace();
+        //! Report the overflow once the new bytes are queued.
+        void CheckHighWatermark();
+        //! Report the drained send queue and wake the blocked callers.
+        //! \warning Must be called from the event loop thread.
+        void CheckLowWatermark();
+        //! Wake the Push() callers blocked on overflow.
+        void NotifySendSpace();
 
         //! Check if has something to send.
-        //! /return send_buffer || send_queue.size()
+        //! /return send_frames or any of send_queues isn't empty
+        //! \warning Must be called from the event loop thread.
         bool HasSomethingToSend();
 
         //! Pass the Requests through assigned handlers.
@@ -148,6 +333,56 @@ namespace DowowNetwork {
                 Was the Request processed by some handler?
         */
         bool PassThroughHandlers(Request* req);
+        //! Push the Request to the send queue.
+        /*! \param call the call to register for the response,
+         *         null-pointer if not waiting for it
+         *  \param timeout seconds before the asynchronous call expires,
+         *         negative for infinity
+         *  \param priority the send queue lane, see SendPriority
+         *  \param is_bounded to obey the send watermarks?
+         *  \return false if not connected or the send queue is
+         *          overflowed (the Request isn't pushed).
+         */
+        bool Enqueue(
+            Request* r,
+            bool to_copy,
+            bool change_id,
+            PendingCall *call,
+            int timeout,
+            uint8_t priority,
+            bool is_bounded = true);
+        //! Register the call waiting for the response.
+        /*! \return false if the connection is stopping. */
+        bool AddPendingCall(uint32_t id, PendingCall *call, int timeout);
+        //! Wait for the call to be completed.
+        /*! \param timeout seconds, negative for infinity
+         *  \return The response or null-pointer.
+         */
+        Request* WaitPendingCall(PendingCall *call, int timeout);
+        //! Pass the response to the call waiting for it.
+        /*! \return false if no call is waiting for the Request. */
+        bool CompletePendingCall(Request* r);
+        //! Complete all the calls with null-pointers.
+        void CancelPendingCalls();
+        //! Call the PullAsync() callbacks with null-pointers.
+        void CancelPullCallbacks();
+        //! Complete the asynchronous calls which deadlines passed.
+        void ExpirePendingCalls();
+        //! Set the calls timer to the earliest deadline.
+        //! \warning mutex_pc must be locked.
+        void ArmCallsTimer();
+        //! Handle the received Request or push it to the receive queue.
+        /*! With a handler pool the Request is queued for RunHandlers(). */
+        void DispatchReceived(Request* req);
+        //! Push the Request to the receive queue.
+        void PushReceived(Request* req);
+        //! Resume the reading if the receive queue is pulled enough.
+        //! \warning mutex_rq must be locked.
+        void ResumeIfPulled();
+        //! Handle the queued Requests one by one (in the pool).
+        /*! The connection is referenced while this runs, so it isn't
+         *  finalized in the middle. */
+        void RunHandlers();
     protected:
         /// This constructor does nothing.
         /*!
@@ -156,7 +391,7 @@ namespace DowowNetwork {
         */
         Connection();
 
-        //! Delete the send buffer.
+        //! Delete the serialized requests being sent.
         void DeleteSendBuffer();
         //! Delete the receive buffer.
         //! Also resets is_recv_length.
@@ -166,40 +401,72 @@ namespace DowowNetwork {
         /*! \return     true if no errors occured, false if the connection
          *              is broken.
          *  \warning    This function isn't MT-Safe and must only
-         *              be called from within ConnThreadFunc()!
+         *              be called from within ConnEventFunc()!
          */
         bool Receive();
+        //! Parse the received bytes into Requests.
+        /*! Handles any amount of whole and partial Requests. Once
+         *  paused, the rest is held back until resumed.
+         *  \return     true if no errors occured, false if the data
+         *              is broken.
+         *  \warning    This function isn't MT-Safe and must only
+         *              be called from within the event loop thread!
+         */
+        bool Consume(const char *data, uint32_t length);
+        //! Parse the bytes held back while paused.
+        /*! \return     See Consume().
+         *  \warning    Must only be called from within the event
+         *              loop thread!
+         */
+        bool ConsumeBacklog();
         //! Perform send I/O.
-        /*! Automatically calls PopSendQueue if needed.
+        /*! Gathers the queued requests with PopSendQueue() and writes
+         *  as many of them as fit into the socket send buffer with one
+         *  sendmsg().
          *  \return     true if no errors occured, false if the connection
          *              is broken.
          *  \warning    This function isn't MT-Safe and must only
-         *              be called from within ConnThreadFunc()!
+         *              be called from within ConnEventFunc()!
          */
         bool Send();
 
-        //! send_queue -> send_buffer.
-        /*! Pops the first request in send_queue and
-            puts it to the send buffer.
-            \return true if the queue wasn't empty.
-            \warning The old buffer is not deleted!
+        //! send_queues -> send_frames.
+        /*! Pops the first request of the highest priority lane and
+            puts it before the gathered frames of the lower lanes
+            (after the one being sent partially).
+            \param priority the lowest lane to pop from
+            \return true if the lanes weren't empty.
         */
-        bool PopSendQueue();
+        bool PopSendQueue(uint8_t priority = SendPrioritiesAmount - 1);
 
         //! Initialize the connection with connected socket.
         /*! - Automatically guesses the domain.
-         *  - Creates the 'push', 'to stop' events.
-         *  - Creates 'our still alive', 'their not alive' timers.
+         *  - Starts 'our still alive', 'their not alive' timers.
          *  - Resets the 'stopped' event.
          *  - Resets the free request id (even/odd is not touched).
          *  - Clears the receive queue.
-         *  - Starts the background thread.
+         *  - Attaches the connection to an event loop.
+         *  \param socket_fd the connected socket
+         *  \param serving_loop the loop to serve the connection,
+         *         null-pointer to use PickLoop()
          *  \warning Not MT-Safe!
          */
-        void InitializeByFD(int socket_fd);
+        void InitializeByFD(int socket_fd, EventLoop *serving_loop = 0);
+
+        //! Get the loop to serve the next connection: the fixed one,
+        //! one of the reactor or the own one (created if needed).
+        EventLoop* PickLoop();
 
         //! Set the even or odd request ids part.
         void SetEvenRequestIdsPart(bool state);
+
+        //! Apply the busy-poll budget to the own loop and the socket.
+        //! \warning The connection must be polling.
+        void ApplyBusyPoll();
+
+        //! Set the backend of the own event loop.
+        //! Takes effect when the own loop is created.
+        void SetIoBackend(uint8_t io_backend);
     public:
         //! Connection ID.
         uint32_t id = 0;
@@ -208,7 +475,156 @@ namespace DowowNetwork {
 
         //! Default constructor.
         //! Effectively just calls InitializeByFD().
-        Connection(int socket_fd);
+        /*!
+            \param socket_fd the connected socket
+            \param reactor the reactor to serve the connection,
+                   null-pointer for the own polling thread
+            \param io_backend the backend of the own polling thread,
+                   not used with a reactor
+            \param cpu the CPU to pin the own polling thread to,
+                   negative to leave it floating
+            \param is_receiving to read the socket at once?
+                   See SetReceiving().
+            \warning
+                The connection created not receiving isn't finalized
+                (so it stays valid even if disconnected meanwhile)
+                until StartReceiving() or SetReceiving() is called.
+        */
+        Connection(
+            int socket_fd,
+            Reactor *reactor = 0,
+            uint8_t io_backend = IoBackendEpoll,
+            int32_t cpu = -1,
+            bool is_receiving = true);
+        //! Create the connection served by the specified loop.
+        /*!
+            \param socket_fd the connected socket
+            \param loop the loop to serve the connection
+            \param is_receiving to read the socket at once?
+                   See SetReceiving().
+            \warning See the constructor above.
+        */
+        Connection(int socket_fd, EventLoop *loop, bool is_receiving = true);
+
+        //! Set the reactor to serve the connection.
+        /*! Takes effect on the next connection. Null-pointer makes
+         *  the connection use its own polling thread.
+         */
+        void SetReactor(Reactor *reactor);
+        //! Get the reactor serving the connection.
+        Reactor* GetReactor();
+
+        //! Set the pool to run the handlers.
+        /*! Null-pointer (default) makes the handlers run in the
+         *  event loop thread. Affects the Requests received after
+         *  the call.
+         *  \warning The pool must outlive the connection.
+         */
+        void SetHandlerPool(HandlerPool *pool);
+        //! Get the pool running the handlers.
+        HandlerPool* GetHandlerPool();
+
+        //! Get the event loop serving the connection.
+        /*! \return The loop, valid while connected. */
+        EventLoop* GetLoop();
+
+        //! Start or stop reading the socket.
+        /*! MT-Safe. While not receiving, the incoming data waits in
+         *  the kernel (and the peer is eventually slowed down by TCP),
+         *  the sending goes on. Takes effect at once and on the next
+         *  connections.
+         */
+        void SetReceiving(bool is_receiving);
+        //! Start receiving the connection created not receiving.
+        /*! MT-Safe. Does nothing if SetReceiving() is called since
+         *  the creation. Releases the connection either way.
+         */
+        void StartReceiving();
+        //! Check if the socket is read.
+        bool IsReceiving();
+
+        //! Limit the receive queue.
+        /*! MT-Safe. Once the amount of the received Requests waiting
+         *  to be pulled gets to the limit, the socket isn't read (so
+         *  TCP slows the peer down) until Pull() takes a half of them.
+         *  The bytes read beyond the limit (a chunk, the io_uring
+         *  receive in flight) are held back and parsed once resumed.
+         *  The handled Requests aren't queued.
+         *  Takes effect at once and on the next connections.
+         *  \param limit the amount of Requests, 0 for unlimited
+         */
+        void SetRecvQueueLimit(uint32_t limit);
+        //! Get the receive queue limit, 0 if unlimited.
+        uint32_t GetRecvQueueLimit();
+
+        //! Get the I/O backend actually used.
+        //! \sa IoBackend.
+        uint8_t GetIoBackend();
+
+        //! Set the CPU to pin the own polling thread to.
+        /*! Takes effect when the own polling thread is created
+         *  (on the first connection), not used with a reactor.
+         *  \param cpu the CPU index, negative to leave it floating
+         */
+        void SetLoopCpu(int32_t cpu);
+        //! Get the CPU the polling thread is pinned to, negative if floating.
+        int32_t GetLoopCpu();
+
+        //! Set the busy-poll budget.
+        /*! The own polling thread spins for up to the budget before
+         *  it sleeps, so a request that comes meanwhile is handled
+         *  without the wakeup latency. TCP sockets also get
+         *  SO_BUSY_POLL (it may need CAP_NET_ADMIN, failures are
+         *  ignored). Use Reactor::SetBusyPoll() for the reactor loops.
+         *  Takes effect at once and on the next connections.
+         *  \param us the budget in microseconds, 0 to turn it off
+         */
+        void SetBusyPoll(uint32_t us);
+        //! Get the busy-poll budget in microseconds.
+        uint32_t GetBusyPoll();
+
+        //! MT-Safe. The amount of bytes pushed and not sent yet.
+        uint32_t GetUnsentBytes();
+        //! MT-Safe. The amount of calls waiting for the responses.
+        uint32_t GetPendingCallsAmount();
+
+        //! Bound the send queue.
+        /*! MT-Safe. Once the bytes pushed and not sent yet get to the
+         *  high watermark, Push() blocks, fails or drops the requests
+         *  (see SetOverflowMode()) until the queue is drained to the
+         *  low watermark. The keep-alives are never held back. TCP
+         *  sockets also get TCP_NOTSENT_LOWAT set to the low watermark,
+         *  so the kernel doesn't buffer much more than that either.
+         *  Takes effect at once and on the next connections.
+         *  \param high the high watermark in bytes, 0 for unlimited
+         *  \param low the low watermark in bytes, not above high
+         */
+        void SetSendWatermarks(uint32_t high, uint32_t low);
+        //! Get the high watermark of the send queue, 0 if unlimited.
+        uint32_t GetSendHighWatermark();
+        //! Get the low watermark of the send queue.
+        uint32_t GetSendLowWatermark();
+
+        //! Set what Push() does when the send queue is overflowed.
+        /*! MT-Safe. OverflowModeBlock by default. The blocked Push()
+         *  returns once there's room or the connection is disconnecting.
+         *  A Push() from the event loop thread never blocks, it fails.
+         *  The dropped requests are accepted and thrown away: the
+         *  calls waiting for their responses get null-pointer at once.
+         *  \sa OverflowMode.
+         */
+        void SetOverflowMode(uint8_t mode);
+        //! Get what Push() does when the send queue is overflowed.
+        uint8_t GetOverflowMode();
+        //! MT-Safe. The amount of requests refused or dropped on overflow.
+        uint64_t GetOverflowsAmount();
+
+        //! Set the handler called when the send queue gets to the high watermark.
+        /*! It's called in the pushing thread, so it must not block. */
+        void SetHighWatermarkHandler(WatermarkHandler h);
+        //! Set the handler called when the send queue is drained to the low watermark.
+        /*! It's called in the event loop thread, so it must not block. */
+        void SetLowWatermarkHandler(WatermarkHandler h);
 
         //! Set 'our still alive' timer interval.
         void SetOurSaInterval(time_t interval);
@@ -225,10 +641,19 @@ namespace DowowNetwork {
          *  - timeout > 0: seconds to wait for the response
          *  - timeout == 0: do not wait for the response
          *  - timeout < 0: wait for the response infinitely long
+         *
+         *  The response is the Request received with the same ID, it's
+         *  returned here instead of being handled or pulled. Any amount
+         *  of calls may wait for their responses at once.
+         *
+         *  The Requests of a higher priority overtake the queued ones
+         *  of the lower priorities (but not the one being sent), the
+         *  Requests of the same priority are sent in order.
          *  \param r the Request to send
          *  \param to_copy to copy the Request?
          *  \param timeout how long to wait for response?
          *  \param change_id to change the request ID to a free one?
+         *  \param priority the send queue lane, see SendPriority
          *  \return
          *      -   If timeout is non-zero then a pointer to the response [YOURS]
          *          or null-pointer (on disconnection or timed out)
@@ -236,18 +661,82 @@ namespace DowowNetwork {
          *  \warning
          *      [YOURS] Please make sure you delete the returned Request
          *      when it's not needed anymore.
+         *  \warning
+         *      Do not wait for the response in a handler run by the
+         *      event loop thread, the response is received by that
+         *      thread. Use a HandlerPool for such handlers.
          */
-        Request* Push(Request* r, bool to_copy = true, int timeout = 0, bool change_id = true);
-        //! \sa Push(Request*, bool, int, bool) 
-        Request* Push(const Request& r, int timeout = 0, bool change_id = true);
+        Request* Push(
+            Request* r,
+            bool to_copy = true,
+            int timeout = 0,
+            bool change_id = true,
+            uint8_t priority = SendPriorityNormal);
+        //! \sa Push(Request*, bool, int, bool, uint8_t)
+        Request* Push(
+            const Request& r,
+            int timeout = 0,
+            bool change_id = true,
+            uint8_t priority = SendPriorityNormal);
+
+        //! Push the Request and get the response asynchronously.
+        /*! MT-Safe. Returns immediately, the callback is called exactly
+         *  once: with the response, or with null-pointer if the call is
+         *  timed out or the connection is lost. It's called in the event
+         *  loop thread (in the calling thread if not connected), so it
+         *  must not block.
+         *  \param r the Request to send
+         *  \param timeout seconds to wait for the response,
+         *         negative for infinity
+         *  \param callback the completion callback
+         *  \param change_id to change the request ID to a free one?
+         *  \param priority the send queue lane, see SendPriority
+         *  \return false if not connected.
+         */
+        bool PushAsync(
+            const Request& r,
+            int timeout,
+            ResponseCallback callback,
+            bool change_id = true,
+            uint8_t priority = SendPriorityNormal);
+        //! Push the Request and get the future response.
+        /*! \return The future of the response [YOURS] or null-pointer.
+         *  \sa PushAsync().
+         */
+        std::future<Request*> PushFuture(
+            const Request& r,
+            int timeout = -1,
+            bool change_id = true,
+            uint8_t priority = SendPriorityNormal);
 
         //! Pull the request from the receive queue.
-        /*! MT-Safe.
-         *  \param timeout how long to wait for request?
+        /*! MT-Safe. Any amount of threads may wait at once, each
+         *  request is pulled by one of them.
+         *  \param timeout how long to wait for request (milliseconds),
+         *         -1 to wait until the connection is lost
          *  \return The pulled request on success, null-pointer if
          *          the queue is empty.
          */
         Request* Pull(int timeout = 0);
+        //! Pull several requests from the receive queue at once.
+        /*! MT-Safe. Waits like Pull() for the first request, then takes
+         *  everything queued (up to max) under one lock.
+         *  \param requests the array to put the requests [YOURS] to
+         *  \param max the size of the array
+         *  \param timeout see Pull()
+         *  \return The amount of the pulled requests.
+         */
+        uint32_t PullMany(Request **requests, uint32_t max, int timeout = 0);
+        //! Pull the request from the receive queue asynchronously.
+        /*! MT-Safe. The callback is called exactly once: with the
+         *  pulled request [YOURS], or with null-pointer if the
+         *  connection is lost. It's called in the calling thread if
+         *  the queue isn't empty, otherwise in the thread receiving the
+         *  request, so it must not block. The callers get the requests
+         *  in the order they called.
+         *  \param callback the completion callback
+         */
+        void PullAsync(ResponseCallback callback);
 
         /// MT-Safe
         uint32_t GetRefs();
@@ -258,21 +747,40 @@ namespace DowowNetwork {
 
         /// \warning    Do not call this function in non-multithreaded handler
         //              if you are also waiting for join. Deadlock will happen.
+        //              With a Reactor the same applies to the handlers of
+        //              all the connections served by the same event loop.
         void Disconnect(bool forced = false, bool wait_for_join = false);
+        /// MT-Safe. Connected, draining or stopping.
         bool IsConnected();
+        /// MT-Safe. Draining or stopping.
         bool IsDisconnecting();
+        /// MT-Safe. The lifecycle stage, see ConnectionState.
+        uint8_t GetState();
+        /// MT-Safe. Is the last graceful disconnection finished by
+        /// sending everything (not by an error or a forcible stop)?
+        bool IsDrained();
 
+        /// MT-Safe. SocketTypeUndefined if not connected.
         uint8_t GetType();
 
         int GetStoppedEvent();
         bool WaitForStop(int timeout = -1);
 
+        /// MT-Safe, the handlers may be changed by the handlers.
         void SetHandlerDefault(RequestHandler h);
+        /// MT-Safe.
         RequestHandler GetHandlerDefault();
 
+        /// MT-Safe, the handlers may be changed by the handlers.
         void SetHandlerNamed(std::string name, RequestHandler h);
+        /// MT-Safe.
         RequestHandler GetHandlerNamed(std::string name);
 
+        //! Set the maximum amount of bytes sent at a time.
+        /*! The queued requests are gathered into one send until the
+         *  socket send buffer is filled (or IOV_MAX of them), the
+         *  block size caps that further. 0 (default) for no cap.
+         */
         void SetSendBlockSize(uint32_t bs);
         uint32_t GetSendBlockSize();
 
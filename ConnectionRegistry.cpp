@@ -0,0 +1,142 @@
+#include "ConnectionRegistry.hpp"
+
+#include <functional>
+
+DowowNetwork::ConnectionRegistry::ConnectionRegistry() : amount(0) {
+    for (auto& shard : shards)
+        pthread_rwlock_init(&shard.lock, 0);
+}
+
+DowowNetwork::ConnectionRegistry::Shard& DowowNetwork::ConnectionRegistry::IdShard(uint32_t id) {
+    return shards[id % REGISTRY_SHARDS];
+}
+
+DowowNetwork::ConnectionRegistry::Shard& DowowNetwork::ConnectionRegistry::TagShard(const std::string& tag) {
+    return shards[std::hash<std::string>()(tag) % REGISTRY_SHARDS];
+}
+
+DowowNetwork::SafeConnection DowowNetwork::ConnectionRegistry::Hold(Connection *c) {
+    // referenced first, the connection can't be finalized after the check
+    SafeConnection result(c);
+    uint8_t state = c->GetState();
+    if (state == ConnectionStateStopping || state == ConnectionStateStopped)
+        result.Reset();
+    return result;
+}
+
+void DowowNetwork::ConnectionRegistry::Add(Connection *c) {
+    std::lock_guard<std::mutex> __mt(mutex_tags);
+
+    Shard& id_shard = IdShard(c->id);
+    pthread_rwlock_wrlock(&id_shard.lock);
+    id_shard.by_id[c->id] = c;
+    pthread_rwlock_unlock(&id_shard.lock);
+
+    // tagged before it was added
+    if (c->tag.size()) {
+        Shard& tag_shard = TagShard(c->tag);
+        pthread_rwlock_wrlock(&tag_shard.lock);
+        tag_shard.by_tag[c->tag] = c;
+        pthread_rwlock_unlock(&tag_shard.lock);
+    }
+
+    amount++;
+}
+
+void DowowNetwork::ConnectionRegistry::Remove(Connection *c) {
+    std::lock_guard<std::mutex> __mt(mutex_tags);
+
+    Shard& id_shard = IdShard(c->id);
+    pthread_rwlock_wrlock(&id_shard.lock);
+    bool is_found = id_shard.by_id.erase(c->id);
+    pthread_rwlock_unlock(&id_shard.lock);
+    if (!is_found) return;
+
+    if (c->tag.size()) {
+        Shard& tag_shard = TagShard(c->tag);
+        pthread_rwlock_wrlock(&tag_shard.lock);
+        // the tag might be taken by another connection
+        auto it = tag_shard.by_tag.find(c->tag);
+        if (it != tag_shard.by_tag.end() && it->second == c)
+            tag_shard.by_tag.erase(it);
+        pthread_rwlock_unlock(&tag_shard.lock);
+    }
+
+    amount--;
+}
+
+void DowowNetwork::ConnectionRegistry::SetTag(Connection *c, const std::string& tag) {
+    std::lock_guard<std::mutex> __mt(mutex_tags);
+
+    // not registered (yet), Add() indexes the tag
+    Shard& id_shard = IdShard(c->id);
+    pthread_rwlock_rdlock(&id_shard.lock);
+    auto it = id_shard.by_id.find(c->id);
+    bool is_registered = it != id_shard.by_id.end() && it->second == c;
+    pthread_rwlock_unlock(&id_shard.lock);
+    if (!is_registered) {
+        c->tag = tag;
+        return;
+    }
+
+    // unindex the old tag
+    if (c->tag.size()) {
+        Shard& old_shard = TagShard(c->tag);
+        pthread_rwlock_wrlock(&old_shard.lock);
+        auto it = old_shard.by_tag.find(c->tag);
+        if (it != old_shard.by_tag.end() && it->second == c)
+            old_shard.by_tag.erase(it);
+        pthread_rwlock_unlock(&old_shard.lock);
+    }
+
+    c->tag = tag;
+
+    // index the new one
+    if (tag.size()) {
+        Shard& new_shard = TagShard(tag);
+        pthread_rwlock_wrlock(&new_shard.lock);
+        new_shard.by_tag[tag] = c;
+        pthread_rwlock_unlock(&new_shard.lock);
+    }
+}
+
+DowowNetwork::SafeConnection DowowNetwork::ConnectionRegistry::Find(uint32_t id) {
+    SafeConnection result;
+
+    Shard& shard = IdShard(id);
+    pthread_rwlock_rdlock(&shard.lock);
+    auto it = shard.by_id.find(id);
+    if (it != shard.by_id.end()) result = Hold(it->second);
+    pthread_rwlock_unlock(&shard.lock);
+
+    return result;
+}
+
+DowowNetwork::SafeConnection DowowNetwork::ConnectionRegistry::Find(const std::string& tag) {
+    SafeConnection result;
+
+    Shard& shard = TagShard(tag);
+    pthread_rwlock_rdlock(&shard.lock);
+    auto it = shard.by_tag.find(tag);
+    if (it != shard.by_tag.end()) result = Hold(it->second);
+    pthread_rwlock_unlock(&shard.lock);
+
+    return result;
+}
+
+uint32_t DowowNetwork::ConnectionRegistry::GetAmount() {
+    return amount;
+}
+
+std::vector<DowowNetwork::SafeConnection> DowowNetwork::ConnectionRegistry::Snapshot() {
+    std::vector<SafeConnection> result;
+    // might be slightly off, it's only a hint
+    result.reserve(amount);
+    ForEach([&](SafeConnection& c) { result.push_back(c); });
+    return result;
+}
+
+DowowNetwork::ConnectionRegistry::~ConnectionRegistry() {
+    for (auto& shard : shards)
+        pthread_rwlock_destroy(&shard.lock);
+}
@@ -0,0 +1,121 @@
+/*!
+    \file
+
+    This file defines the ConnectionRegistry class.
+*/
+
+#ifndef __DOWOW_NETWORK__CONNECTION_REGISTRY_H_
+#define __DOWOW_NETWORK__CONNECTION_REGISTRY_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include <pthread.h>
+
+#include "Connection.hpp"
+#include "SafeConnection.hpp"
+
+// amount of shards of the registry
+#define REGISTRY_SHARDS 16
+
+namespace DowowNetwork {
+    //! The connections indexed by their IDs and tags.
+    /*!
+        The indices are split into shards, each under its own
+        reader-writer lock, so the lookups run concurrently and
+        don't contend with the additions to the other shards.
+        A connection is found by its ID in the shard id % REGISTRY_SHARDS
+        and by its tag in the shard of the tag hash.
+
+        The lookups return the handles to the connections, the ones
+        being stopped are not found.
+    */
+    class ConnectionRegistry {
+    private:
+        //! A part of the indices.
+        struct Shard {
+            //! Many lookups or one change at a time.
+            pthread_rwlock_t lock;
+            //! The connections by their IDs.
+            std::unordered_map<uint32_t, Connection*> by_id;
+            //! The connections by their tags (the last tagged wins).
+            std::unordered_map<std::string, Connection*> by_tag;
+        };
+
+        //! The shards.
+        Shard shards[REGISTRY_SHARDS];
+        //! Amount of the registered connections.
+        std::atomic<uint32_t> amount;
+        //! Serializes the tag changes (they touch two shards).
+        std::mutex mutex_tags;
+
+        //! Get the shard indexing the ID.
+        Shard& IdShard(uint32_t id);
+        //! Get the shard indexing the tag.
+        Shard& TagShard(const std::string& tag);
+
+        //! Get the handle unless the connection is being stopped.
+        static SafeConnection Hold(Connection *c);
+    public:
+        ConnectionRegistry();
+
+        ConnectionRegistry(const ConnectionRegistry&) = delete;
+        ConnectionRegistry& operator=(const ConnectionRegistry&) = delete;
+
+        //! Register the connection by its ID and tag (if set).
+        //! MT-Safe.
+        void Add(Connection *c);
+        //! Unregister the connection.
+        //! MT-Safe.
+        void Remove(Connection *c);
+
+        //! Change the tag of the connection.
+        /*! MT-Safe.
+         *  Works for an unregistered connection too, the tag is
+         *  indexed once it's added.
+         */
+        void SetTag(Connection *c, const std::string& tag);
+
+        //! Find the connection by its ID.
+        //! MT-Safe.
+        SafeConnection Find(uint32_t id);
+        //! Find the connection by its tag.
+        //! MT-Safe.
+        SafeConnection Find(const std::string& tag);
+
+        //! Get the amount of the registered connections.
+        uint32_t GetAmount();
+
+        //! Get the handles to all the connections.
+        /*! MT-Safe.
+         *  The snapshot keeps the connections alive, but doesn't
+         *  see the ones registered later.
+         */
+        std::vector<SafeConnection> Snapshot();
+
+        //! Call the function for every connection.
+        /*! MT-Safe.
+         *  The function gets a SafeConnection&. One shard is read-locked
+         *  at a time, so the function should not block, nor change
+         *  the registry.
+         */
+        template<typename F> void ForEach(F f) {
+            for (auto& shard : shards) {
+                pthread_rwlock_rdlock(&shard.lock);
+                for (auto& i : shard.by_id) {
+                    SafeConnection c = Hold(i.second);
+                    if (c) f(c);
+                }
+                pthread_rwlock_unlock(&shard.lock);
+            }
+        }
+
+        ~ConnectionRegistry();
+    };
+}
+
+#endif
@@ -0,0 +1,26 @@
+/*!
+    \file
+
+    This file declares ConnectionState enum.
+*/
+
+#ifndef __DOWOW_NETWORK__CONNECTION_STATE_H_
+#define __DOWOW_NETWORK__CONNECTION_STATE_H_
+
+#include <cstdint>
+
+namespace DowowNetwork {
+    /// The lifecycle stage of a Connection
+    /*!
+        Stopped -> Connecting -> Connected [-> Draining] -> Stopping -> Stopped
+    */
+    enum ConnectionState : uint8_t {
+        ConnectionStateStopped = 0,     ///< not connected
+        ConnectionStateConnecting = 1,  ///< the socket is being attached to a loop
+        ConnectionStateConnected = 2,   ///< sending and receiving
+        ConnectionStateDraining = 3,    ///< sending the queued requests before the stop
+        ConnectionStateStopping = 4     ///< waiting for the references to be released
+    };
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*!
+    \file
+
+    This file defines the C++20 coroutine front-end of the Connection.
+    It's empty unless the compiler supports coroutines.
+*/
+
+#ifndef __DOWOW_NETWORK__COROUTINE_H_
+#define __DOWOW_NETWORK__COROUTINE_H_
+
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+
+#include "Connection.hpp"
+#include "Request.hpp"
+
+namespace DowowNetwork {
+    //! A fire-and-forget coroutine.
+    /*!
+        Starts running at once, frees itself when finished. Use it as
+        the return type of the coroutine request handlers.
+
+        \code
+        Task HandlerSum(Connection *c, Request *r) {
+            Request *a = co_await Call(c, Request("get_a"), 5);
+            ...
+        }
+        ...
+        c->SetHandlerNamed("sum", CoHandler<HandlerSum>);
+        \endcode
+    */
+    struct Task {
+        struct promise_type {
+            Task get_return_object() { return Task(); }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    //! The coroutine request handler prototype.
+    typedef Task (*CoRequestHandler)(Connection* c, Request* r);
+
+    //! Adapt the coroutine to a RequestHandler.
+    /*!
+        The coroutine runs in the handler thread until it's suspended
+        for the first time, then it's resumed in the event loop thread.
+        So the Requests of the same Connection are handled in order
+        only until their handlers suspend.
+
+        \warning
+            The Connection is valid after the resumption only if the
+            awaited result is not null-pointer (or the Connection is
+            referenced by IncreaseRefs()).
+    */
+    template<CoRequestHandler H> void CoHandler(Connection* c, Request* r) {
+        H(c, r);
+    }
+
+    //! Awaits the completion callback.
+    /*!
+        The callback may be called before the coroutine is suspended
+        (even in the same thread), then it's not suspended at all.
+    */
+    class CallbackAwaiter {
+    private:
+        //! 0 - waiting, 1 - completed, 2 - suspended.
+        std::atomic<int> state;
+        //! The result passed to the callback.
+        Request *result = 0;
+    protected:
+        //! Start the operation calling the callback.
+        virtual void Start(ResponseCallback callback) = 0;
+    public:
+        CallbackAwaiter() : state(0) {}
+
+        bool await_ready() { return false; }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            Start([this, h](Connection *c, Request *r) {
+                result = r;
+                // resume only if already suspended
+                if (state.exchange(1) == 2) h.resume();
+            });
+            // don't suspend if already completed
+            return state.exchange(2) != 1;
+        }
+
+        Request* await_resume() { return result; }
+    };
+
+    //! Awaits the response to the pushed Request.
+    /*! \sa Call(). */
+    class CallAwaiter : public CallbackAwaiter {
+    private:
+        Connection *conn;
+        //! A copy, the awaiter may outlive the passed (temporary) one.
+        Request req;
+        int timeout;
+        bool change_id;
+    protected:
+        void Start(ResponseCallback callback) override {
+            conn->PushAsync(req, timeout, callback, change_id);
+        }
+    public:
+        CallAwaiter(Connection *c, const Request& r, int timeout, bool change_id) :
+            conn(c), timeout(timeout), change_id(change_id)
+        {
+            req.CopyFrom(&r);
+        }
+    };
+
+    //! Awaits the next Request of the receive queue.
+    /*! \sa Next(). */
+    class PullAwaiter : public CallbackAwaiter {
+    private:
+        Connection *conn;
+    protected:
+        void Start(ResponseCallback callback) override {
+            conn->PullAsync(callback);
+        }
+    public:
+        explicit PullAwaiter(Connection *c) : conn(c) {}
+    };
+
+    //! Push the Request and await the response.
+    /*!
+        Doesn't block the thread, the coroutine is suspended until the
+        response arrives (or the call is timed out or the connection is
+        lost) and resumed in the event loop thread.
+
+        \return The awaiter of the response [YOURS] or null-pointer.
+        \sa Connection::PushAsync().
+    */
+    inline CallAwaiter Call(Connection *c, const Request& r, int timeout = -1, bool change_id = true) {
+        return CallAwaiter(c, r, timeout, change_id);
+    }
+
+    //! Await the next Request of the receive queue.
+    /*!
+        \return The awaiter of the Request [YOURS] or null-pointer
+                if the connection is lost.
+        \sa Connection::PullAsync().
+    */
+    inline PullAwaiter Next(Connection *c) {
+        return PullAwaiter(c);
+    }
+}
+
+#endif
+
+#endif
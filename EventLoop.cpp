@@ -0,0 +1,687 @@
+#include "EventLoop.hpp"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "Utils.hpp"
+
+// the maximum amount of events processed per epoll_wait()
+#define EVENTS_PER_WAIT 64
+
+// the timer wheel size in milliseconds (must be a power of 2)
+#define TIMER_WHEEL_SIZE 4096
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+
+// io_uring submission entries
+#define URING_ENTRIES 256
+// io_uring provided buffers
+#define URING_BUFFERS 64
+// io_uring provided buffer size
+#define URING_BUFFER_SIZE 4096
+
+// io_uring user data: slot index, operation kind and generation
+#define URING_GEN_MASK 0x7fffffffu
+#define URING_RECV_BIT 0x80000000u
+#define URING_USER_DATA(slot, kind, gen) \
+    ((static_cast<uint64_t>(slot) << 32) | (kind) | ((gen) & URING_GEN_MASK))
+
+void DowowNetwork::EventLoop::LoopThreadFunc(EventLoop *loop) {
+    // before anything is allocated in the thread
+    Utils::SetThreadCpu(loop->cpu);
+
+    if (loop->backend == IoBackendIoUring)
+        loop->RunIoUring();
+    else
+        loop->RunEpoll();
+}
+
+void DowowNetwork::EventLoop::RunEpoll() {
+    epoll_event events[EVENTS_PER_WAIT];
+
+    while (!to_stop) {
+        // busy-poll (if enabled), then wait for events
+        int events_amount = SpinEpoll(events);
+        if (events_amount < 0) {
+            events_amount = epoll_wait(
+                epoll_fd,
+                events,
+                EVENTS_PER_WAIT,
+                -1);
+        }
+
+        // process the ready watchers
+        for (int i = 0; i < events_amount; ++i) {
+            Watcher *w = reinterpret_cast<Watcher*>(events[i].data.ptr);
+            // removed while processing this batch
+            if (w->fd == -1) continue;
+            (*w->callback)(w, events[i].events);
+        }
+
+        // run the posted tasks
+        RunTasks();
+    }
+}
+
+void DowowNetwork::EventLoop::RunIoUring() {
+    while (!to_stop) {
+        // arm the operations and wait for completions
+        // (unless they came while busy-polling)
+        FlushSlots();
+        if (!SpinIoUring()) ring->Submit(1);
+
+        // reap the completions
+        while (io_uring_cqe *cqe = ring->PeekCqe()) {
+            uint64_t user_data = cqe->user_data;
+            int32_t res = cqe->res;
+            uint32_t flags = cqe->flags;
+            ring->PopCqe();
+
+            // a cancellation or a failed buffer recycling
+            if (user_data == IoUring::internal_user_data) continue;
+
+            ProcessCqe(user_data, res, flags);
+        }
+
+        // run the posted tasks
+        RunTasks();
+    }
+}
+
+int DowowNetwork::EventLoop::SpinEpoll(epoll_event *events) {
+    uint32_t budget = busy_poll_us.load(std::memory_order_relaxed);
+    if (!budget) return -1;
+
+    is_spinning = true;
+    uint64_t until = Utils::GetMonotonicUS() + budget;
+    int events_amount;
+    do {
+        events_amount = epoll_wait(epoll_fd, events, EVENTS_PER_WAIT, 0);
+        if (events_amount > 0) break;
+        events_amount = 0;
+        if (is_wakeup_pending) break;
+        // let the peer run if it shares the core
+        sched_yield();
+    } while (Utils::GetMonotonicUS() < until);
+
+    if (StopSpinning() || events_amount) return events_amount;
+    return -1;
+}
+
+bool DowowNetwork::EventLoop::SpinIoUring() {
+    uint32_t budget = busy_poll_us.load(std::memory_order_relaxed);
+    if (!budget) return false;
+
+    is_spinning = true;
+    uint64_t until = Utils::GetMonotonicUS() + budget;
+    bool is_ready;
+    do {
+        ring->Poll();
+        is_ready = ring->PeekCqe() || is_wakeup_pending;
+        if (!is_ready) sched_yield();
+    } while (!is_ready && Utils::GetMonotonicUS() < until);
+
+    return StopSpinning() || is_ready;
+}
+
+bool DowowNetwork::EventLoop::StopSpinning() {
+    // pairs with WriteWakeup(): either it sees that the loop doesn't
+    // spin anymore and writes the event, or the loop sees the flag
+    is_spinning = false;
+    return is_wakeup_pending;
+}
+
+void DowowNetwork::EventLoop::WakeupFunc(Watcher *w, uint32_t events) {
+    // reset the event, the tasks are run after the batch
+    Utils::ReadEventFd(w->fd, 0);
+}
+
+void DowowNetwork::EventLoop::TimerFunc(Watcher *w, uint32_t events) {
+    EventLoop *loop = reinterpret_cast<EventLoop*>(w->owner);
+
+    // reset the kernel timer
+    Utils::ReadEventFd(w->fd, 0);
+
+    std::vector<Timer*> expired;
+    std::vector<Timer*> postponed;
+
+    loop->mutex_timers.lock();
+
+    // the kernel timer is one-shot
+    loop->armed_time = 0;
+
+    // visit the buckets up to now (each one once at most)
+    uint64_t now = Utils::GetMonotonicMS();
+    uint64_t steps = now > loop->wheel_time ? now - loop->wheel_time : 0;
+    if (steps > TIMER_WHEEL_SIZE) steps = TIMER_WHEEL_SIZE;
+    for (uint64_t i = 1; i <= steps; ++i) {
+        Timer *t = loop->wheel[(loop->wheel_time + i) & TIMER_WHEEL_MASK];
+        while (t) {
+            Timer *next = t->next;
+            loop->UnlinkTimer(t);
+            // the deadline might have been postponed meanwhile
+            if (t->deadline.load(std::memory_order_relaxed) <= now) {
+                t->is_firing = true;
+                expired.push_back(t);
+            } else {
+                postponed.push_back(t);
+            }
+            t = next;
+        }
+    }
+    if (steps) loop->wheel_time = now;
+
+    // the postponed ones go further
+    for (auto t : postponed) loop->LinkTimer(t);
+    loop->ArmTimerFd();
+
+    loop->mutex_timers.unlock();
+
+    // fire the expired ones (unless stopped by the previous callbacks)
+    for (auto t : expired) {
+        loop->mutex_timers.lock();
+        bool to_fire = t->is_firing;
+        t->is_firing = false;
+        loop->mutex_timers.unlock();
+
+        if (to_fire) (*t->callback)(t);
+    }
+}
+
+void DowowNetwork::EventLoop::LinkTimer(Timer *t) {
+    // the wheel is idle, catch up with the time
+    if (!timers_amount) wheel_time = Utils::GetMonotonicMS();
+
+    // the wheel covers (wheel_time, wheel_time + TIMER_WHEEL_SIZE],
+    // the farther timers are relinked when that moment comes
+    uint64_t at = t->deadline.load(std::memory_order_relaxed);
+    if (at <= wheel_time) at = wheel_time + 1;
+    if (at > wheel_time + TIMER_WHEEL_SIZE) at = wheel_time + TIMER_WHEEL_SIZE;
+
+    // put to the head of the bucket
+    t->bucket = at & TIMER_WHEEL_MASK;
+    t->prev = 0;
+    t->next = wheel[t->bucket];
+    if (t->next) t->next->prev = t;
+    wheel[t->bucket] = t;
+
+    t->is_started = true;
+    timers_amount++;
+
+    // earlier than the kernel timer
+    if (!armed_time || at < armed_time) {
+        armed_time = at;
+        Utils::SetTimerFdDeadline(timer_fd, at);
+    }
+}
+
+void DowowNetwork::EventLoop::UnlinkTimer(Timer *t) {
+    if (t->prev) t->prev->next = t->next;
+    else wheel[t->bucket] = t->next;
+    if (t->next) t->next->prev = t->prev;
+    t->prev = 0;
+    t->next = 0;
+
+    t->is_started = false;
+    timers_amount--;
+}
+
+void DowowNetwork::EventLoop::ArmTimerFd() {
+    // the earliest non-empty bucket
+    uint64_t at = 0;
+    if (timers_amount) {
+        for (uint64_t i = 1; i <= TIMER_WHEEL_SIZE; ++i) {
+            if (wheel[(wheel_time + i) & TIMER_WHEEL_MASK]) {
+                at = wheel_time + i;
+                break;
+            }
+        }
+    }
+
+    // already armed for it
+    if (at == armed_time) return;
+
+    armed_time = at;
+    Utils::SetTimerFdDeadline(timer_fd, at);
+}
+
+void DowowNetwork::EventLoop::RunTasks() {
+    std::vector<Watcher*> to_invoke;
+    std::vector<std::function<void()>> to_run;
+
+    // everything added after this point needs a new wakeup
+    is_wakeup_pending = false;
+
+    // take the watchers and the tasks
+    mutex_tasks.lock();
+    to_invoke.swap(notified);
+    to_run.swap(tasks);
+    mutex_tasks.unlock();
+
+    // invoke the watchers (unless removed by the previous ones)
+    for (Watcher *w : to_invoke) {
+        mutex_tasks.lock();
+        bool to_invoke_w = w->is_notified;
+        w->is_notified = false;
+        mutex_tasks.unlock();
+
+        if (to_invoke_w) (*w->callback)(w, 0);
+    }
+
+    // run the tasks
+    for (auto& t : to_run) t();
+}
+
+void DowowNetwork::EventLoop::Wake() {
+    if (!IsInLoopThread())
+        WriteWakeup();
+}
+
+void DowowNetwork::EventLoop::WriteWakeup() {
+    // the loop is woken up already and hasn't taken the tasks yet
+    if (is_wakeup_pending.exchange(true)) return;
+    // the busy-polling loop checks the flag by itself
+    if (is_spinning) return;
+
+    Utils::WriteEventFd(wakeup_event, 1);
+}
+
+void DowowNetwork::EventLoop::MarkDirty(uint32_t slot) {
+    if (slots[slot].is_dirty) return;
+    slots[slot].is_dirty = true;
+    dirty_slots.push_back(slot);
+}
+
+void DowowNetwork::EventLoop::FlushSlots() {
+    std::lock_guard<std::mutex> __ms(mutex_slots);
+
+    for (uint32_t i : dirty_slots) {
+        Slot &s = slots[i];
+        s.is_dirty = false;
+
+        // removed
+        if (!s.w) continue;
+
+        // what we want to be in flight
+        bool recv_wanted =
+            s.w->data_callback &&
+            is_recv_multishot &&
+            (s.w->events & EPOLLIN);
+        uint32_t poll_wanted =
+            s.w->events & ~(recv_wanted ? EPOLLIN : 0);
+
+        // the poll is armed with other events
+        if (s.is_poll_armed && s.armed_events != poll_wanted) {
+            io_uring_sqe *sqe = ring->GetSqe();
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->addr = URING_USER_DATA(i, 0, s.poll_gen);
+            sqe->user_data = IoUring::internal_user_data;
+            s.poll_gen++;
+            s.is_poll_armed = false;
+        }
+        // arm the one-shot poll, it's rearmed after every completion
+        // so it behaves like level-triggered epoll
+        if (!s.is_poll_armed && poll_wanted) {
+            io_uring_sqe *sqe = ring->GetSqe();
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = s.w->fd;
+            sqe->poll32_events = poll_wanted;
+            sqe->user_data = URING_USER_DATA(i, 0, s.poll_gen);
+            s.is_poll_armed = true;
+            s.armed_events = poll_wanted;
+        }
+
+        // the receive is not wanted anymore
+        // remark:  the generation is kept, the completions posted
+        //          before the cancellation carry the data taken from
+        //          the socket already. It's rearmed (if wanted again)
+        //          after the final completion, so the data isn't
+        //          reordered either.
+        if (s.is_recv_armed && !s.is_recv_cancelled && !recv_wanted) {
+            io_uring_sqe *sqe = ring->GetSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = URING_USER_DATA(i, URING_RECV_BIT, s.recv_gen);
+            sqe->user_data = IoUring::internal_user_data;
+            s.is_recv_cancelled = true;
+        }
+        // arm the multishot receive into the provided buffers
+        if (!s.is_recv_armed && recv_wanted) {
+            io_uring_sqe *sqe = ring->GetSqe();
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = s.w->fd;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = IoUring::buffer_group;
+            sqe->user_data = URING_USER_DATA(i, URING_RECV_BIT, s.recv_gen);
+            s.is_recv_armed = true;
+        }
+    }
+
+    dirty_slots.clear();
+}
+
+void DowowNetwork::EventLoop::ProcessCqe(uint64_t user_data, int32_t res, uint32_t flags) {
+    uint32_t slot = user_data >> 32;
+    bool is_recv = user_data & URING_RECV_BIT;
+    uint32_t gen = user_data & URING_GEN_MASK;
+
+    // find the watcher
+    Watcher *w = 0;
+    mutex_slots.lock();
+    Slot &s = slots[slot];
+    if (is_recv) {
+        if (s.w && gen == (s.recv_gen & URING_GEN_MASK)) {
+            w = s.w;
+            // the multishot receive is finished (or cancelled), rearm
+            if (!(flags & IORING_CQE_F_MORE)) {
+                s.is_recv_armed = false;
+                s.is_recv_cancelled = false;
+                MarkDirty(slot);
+            }
+        }
+    } else {
+        if (s.w && gen == (s.poll_gen & URING_GEN_MASK)) {
+            w = s.w;
+            // the one-shot poll is finished, rearm
+            s.is_poll_armed = false;
+            MarkDirty(slot);
+        }
+    }
+    mutex_slots.unlock();
+
+    // the buffer used by the completion
+    bool has_buffer = flags & IORING_CQE_F_BUFFER;
+    uint16_t buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+
+    // a completion of a cancelled operation
+    if (!w) {
+        if (has_buffer) ring->RecycleBuffer(buffer_id);
+        return;
+    }
+
+    // ****
+    // poll
+    // ****
+    if (!is_recv) {
+        if (res > 0) (*w->callback)(w, res);
+        return;
+    }
+
+    // *******
+    // receive
+    // *******
+    if (res > 0 && has_buffer) {
+        (*w->data_callback)(w, ring->GetBuffer(buffer_id), res);
+        ring->RecycleBuffer(buffer_id);
+    } else if (res == 0) {
+        // closed by the peer
+        (*w->data_callback)(w, 0, 0);
+    } else if (res == -EINVAL) {
+        // multishot receive is not supported, poll for EPOLLIN instead
+        std::lock_guard<std::mutex> __ms(mutex_slots);
+        is_recv_multishot = false;
+        MarkDirty(slot);
+    } else if (res != -ENOBUFS && res != -ECANCELED) {
+        // failure
+        (*w->data_callback)(w, 0, res);
+    }
+}
+
+DowowNetwork::EventLoop::EventLoop(uint8_t backend, int32_t cpu) :
+    backend(backend),
+    is_wakeup_pending(false),
+    is_spinning(false),
+    busy_poll_us(0),
+    to_stop(false),
+    load(0),
+    cpu(cpu)
+{
+    // try to set up io_uring
+    if (backend == IoBackendIoUring) {
+        ring = new IoUring(URING_ENTRIES, URING_BUFFERS, URING_BUFFER_SIZE);
+        // not supported, fall back to epoll
+        if (!ring->IsValid()) {
+            delete ring;
+            ring = 0;
+            this->backend = IoBackendEpoll;
+        }
+    }
+
+    // create the descriptors
+    if (this->backend == IoBackendEpoll)
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_event = eventfd(0, EFD_CLOEXEC);
+
+    // watch the wakeup event
+    wakeup_watcher.callback = WakeupFunc;
+    wakeup_watcher.owner = this;
+    Add(&wakeup_watcher, wakeup_event, EPOLLIN);
+
+    // set up the timer wheel
+    wheel.resize(TIMER_WHEEL_SIZE, 0);
+    wheel_time = Utils::GetMonotonicMS();
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    timer_watcher.callback = TimerFunc;
+    timer_watcher.owner = this;
+    Add(&timer_watcher, timer_fd, EPOLLIN);
+
+    // start the loop thread
+    loop_thread = new std::thread(LoopThreadFunc, this);
+}
+
+uint8_t DowowNetwork::EventLoop::GetBackend() {
+    return backend;
+}
+
+int32_t DowowNetwork::EventLoop::GetCpu() {
+    return cpu;
+}
+
+void DowowNetwork::EventLoop::SetBusyPoll(uint32_t us) {
+    busy_poll_us = us;
+}
+
+uint32_t DowowNetwork::EventLoop::GetBusyPoll() {
+    return busy_poll_us;
+}
+
+bool DowowNetwork::EventLoop::Add(Watcher *w, int fd, uint32_t events) {
+    if (backend == IoBackendIoUring) {
+        {
+            std::lock_guard<std::mutex> __ms(mutex_slots);
+
+            // take a free slot
+            uint32_t slot;
+            if (free_slots.size()) {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            } else {
+                slot = slots.size();
+                slots.push_back(Slot());
+            }
+
+            w->fd = fd;
+            w->events = events;
+            w->slot = slot;
+            slots[slot].w = w;
+
+            // arm in the loop thread
+            MarkDirty(slot);
+        }
+        Wake();
+        return true;
+    }
+
+    w->fd = fd;
+    w->events = events;
+
+    epoll_event e;
+    e.events = events;
+    e.data.ptr = w;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &e) == 0;
+}
+
+bool DowowNetwork::EventLoop::Modify(Watcher *w, uint32_t events) {
+    if (backend == IoBackendIoUring) {
+        {
+            std::lock_guard<std::mutex> __ms(mutex_slots);
+
+            // not monitored
+            if (w->fd == -1) return false;
+            // nothing changed
+            if (w->events == events) return true;
+
+            w->events = events;
+
+            // rearm in the loop thread
+            MarkDirty(w->slot);
+        }
+        Wake();
+        return true;
+    }
+
+    // not monitored
+    if (w->fd == -1) return false;
+    // nothing changed
+    if (w->events == events) return true;
+
+    w->events = events;
+
+    epoll_event e;
+    e.events = events;
+    e.data.ptr = w;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, w->fd, &e) == 0;
+}
+
+void DowowNetwork::EventLoop::Remove(Watcher *w) {
+    // drop the notification
+    // (it may be taken by RunTasks() already, then the flag is enough)
+    mutex_tasks.lock();
+    if (w->is_notified) {
+        w->is_notified = false;
+        auto it = std::find(notified.begin(), notified.end(), w);
+        if (it != notified.end()) notified.erase(it);
+    }
+    mutex_tasks.unlock();
+
+    // not monitored
+    if (w->fd == -1) return;
+
+    if (backend == IoBackendIoUring) {
+        std::lock_guard<std::mutex> __ms(mutex_slots);
+        Slot &s = slots[w->slot];
+
+        // cancel the operations in flight,
+        // their completions are ignored due to the new generations
+        if (s.is_poll_armed) {
+            io_uring_sqe *sqe = ring->GetSqe();
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->addr = URING_USER_DATA(w->slot, 0, s.poll_gen);
+            sqe->user_data = IoUring::internal_user_data;
+        }
+        if (s.is_recv_armed) {
+            io_uring_sqe *sqe = ring->GetSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = URING_USER_DATA(w->slot, URING_RECV_BIT, s.recv_gen);
+            sqe->user_data = IoUring::internal_user_data;
+        }
+        s.poll_gen++;
+        s.recv_gen++;
+        s.is_poll_armed = false;
+        s.is_recv_armed = false;
+        s.is_recv_cancelled = false;
+
+        // free the slot
+        s.w = 0;
+        free_slots.push_back(w->slot);
+    } else {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, w->fd, 0);
+    }
+
+    // mark as removed so the current batch skips it
+    w->fd = -1;
+    w->events = 0;
+}
+
+void DowowNetwork::EventLoop::StartTimer(Timer *t, uint64_t deadline) {
+    std::lock_guard<std::mutex> __mt(mutex_timers);
+
+    t->deadline.store(deadline, std::memory_order_relaxed);
+
+    // move to the new bucket
+    if (t->is_started) UnlinkTimer(t);
+    t->is_firing = false;
+    LinkTimer(t);
+}
+
+void DowowNetwork::EventLoop::StopTimer(Timer *t) {
+    std::lock_guard<std::mutex> __mt(mutex_timers);
+
+    // the kernel timer may fire for nothing, that's fine
+    if (t->is_started) UnlinkTimer(t);
+    t->is_firing = false;
+}
+
+void DowowNetwork::EventLoop::Notify(Watcher *w) {
+    mutex_tasks.lock();
+    // already waiting to be invoked
+    if (w->is_notified) {
+        mutex_tasks.unlock();
+        return;
+    }
+    w->is_notified = true;
+    notified.push_back(w);
+    mutex_tasks.unlock();
+
+    // wake the loop thread up
+    WriteWakeup();
+}
+
+void DowowNetwork::EventLoop::Post(std::function<void()> task) {
+    mutex_tasks.lock();
+    tasks.push_back(task);
+    mutex_tasks.unlock();
+
+    // wake the loop thread up
+    WriteWakeup();
+}
+
+bool DowowNetwork::EventLoop::IsInLoopThread() {
+    return
+        loop_thread &&
+        std::this_thread::get_id() == loop_thread->get_id();
+}
+
+void DowowNetwork::EventLoop::Attach() {
+    load++;
+}
+
+void DowowNetwork::EventLoop::Detach() {
+    load--;
+}
+
+uint32_t DowowNetwork::EventLoop::GetLoad() {
+    return load;
+}
+
+DowowNetwork::EventLoop::~EventLoop() {
+    // make the thread stop
+    Post([this]() { to_stop = true; });
+
+    // wait for it
+    loop_thread->join();
+    delete loop_thread;
+
+    // close the descriptors
+    close(wakeup_event);
+    close(timer_fd);
+    if (epoll_fd != -1) close(epoll_fd);
+    delete ring;
+}
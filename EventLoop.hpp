@@ -0,0 +1,343 @@
+/*!
+    \file
+
+    This file defines the EventLoop class, the Watcher and the Timer
+    structures.
+*/
+
+#ifndef __DOWOW_NETWORK__EVENT_LOOP_H_
+#define __DOWOW_NETWORK__EVENT_LOOP_H_
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "IoBackend.hpp"
+#include "IoUring.hpp"
+
+struct epoll_event;
+
+namespace DowowNetwork {
+    // Predeclare the watcher and the timer for typedef
+    struct Watcher;
+    struct Timer;
+
+    //! Watcher callback prototype.
+    /*!
+        \param w the Watcher whose descriptor is ready
+        \param events the epoll events that occurred
+    */
+    typedef void (*WatcherCallback)(Watcher *w, uint32_t events);
+    //! Watcher data callback prototype.
+    /*!
+        \param w the Watcher whose socket received the data
+        \param data the received data, valid during the call only
+        \param length the length of the data, 0 if the peer has
+               closed the connection, -errno on failure
+    */
+    typedef void (*WatcherDataCallback)(Watcher *w, const char *data, int32_t length);
+    //! Timer callback prototype.
+    /*!
+        \param t the Timer whose deadline has come
+    */
+    typedef void (*TimerCallback)(Timer *t);
+
+    //! A file descriptor monitored by an EventLoop.
+    struct Watcher {
+        //! The monitored file descriptor, -1 if not monitored.
+        int fd = -1;
+        //! The epoll events the watcher is interested in.
+        uint32_t events = 0;
+        //! The function called in the loop thread when the fd is ready.
+        WatcherCallback callback = 0;
+        //! The function called in the loop thread with the received
+        //! data instead of EPOLLIN readiness, if the loop receives by
+        //! itself (io_uring backend). Optional, for sockets only.
+        WatcherDataCallback data_callback = 0;
+        //! The object that owns the watcher.
+        void *owner = 0;
+        //! The registration slot (io_uring backend).
+        uint32_t slot = 0;
+        //! Is the watcher waiting to be invoked by EventLoop::Notify()?
+        bool is_notified = false;
+    };
+
+    //! A deadline tracked by the timer wheel of an EventLoop.
+    struct Timer {
+        //! The deadline (Utils::GetMonotonicMS()).
+        //! May be postponed by a plain store, see EventLoop::PostponeTimer().
+        std::atomic<uint64_t> deadline;
+        //! The function called in the loop thread when the deadline comes.
+        TimerCallback callback = 0;
+        //! The object that owns the timer.
+        void *owner = 0;
+
+        //! The neighbours in the wheel bucket.
+        Timer *prev = 0, *next = 0;
+        //! The wheel bucket.
+        uint32_t bucket = 0;
+        //! Is the timer in the wheel?
+        bool is_started = false;
+        //! Is the timer expired and waiting for its callback?
+        bool is_firing = false;
+
+        Timer() : deadline(0) {}
+    };
+
+    //! A thread that runs epoll over many file descriptors.
+    /*!
+        The loop thread is started by the constructor and is running
+        until the loop is destroyed. Watchers are invoked in the loop
+        thread, tasks posted from any thread are run in the loop thread
+        after the ready watchers are processed.
+
+        With the io_uring backend the loop arms one-shot polls and
+        multishot receives (into provided buffers) for the watchers,
+        submits all of them with one system call per iteration and
+        reaps the completions without a poll round-trip.
+    */
+    class EventLoop {
+    private:
+        //! A watcher registered in the io_uring backend.
+        struct Slot {
+            //! The watcher, null-pointer if the slot is free.
+            Watcher *w = 0;
+            //! Generation of the poll operation.
+            uint32_t poll_gen = 0;
+            //! Generation of the receive operation.
+            uint32_t recv_gen = 0;
+            //! The events the poll operation is armed with.
+            uint32_t armed_events = 0;
+            //! Is the poll operation in flight?
+            bool is_poll_armed = false;
+            //! Is the multishot receive in flight?
+            bool is_recv_armed = false;
+            //! Is the cancellation of the multishot receive submitted?
+            /*! The receive stays in flight until its final completion,
+             *  the data it has taken from the socket is delivered.
+             */
+            bool is_recv_cancelled = false;
+            //! Is the slot waiting for FlushSlots()?
+            bool is_dirty = false;
+        };
+
+        //! The backend in use.
+        uint8_t backend;
+
+        //! The epoll file descriptor.
+        int epoll_fd = -1;
+
+        //! The io_uring instance.
+        IoUring *ring = 0;
+        //! Is the multishot receive supported by the kernel?
+        bool is_recv_multishot = true;
+        //! mutex for slots
+        std::mutex mutex_slots;
+        //! The registered watchers.
+        std::vector<Slot> slots;
+        //! The indexes of the free slots.
+        std::vector<uint32_t> free_slots;
+        //! The indexes of the slots with changed events.
+        std::vector<uint32_t> dirty_slots;
+
+        //! Wakeup event.
+        //! Becomes readable when a task is posted.
+        int wakeup_event = -1;
+        //! The watcher of the wakeup event.
+        Watcher wakeup_watcher;
+        //! Is the wakeup event written and not processed yet?
+        std::atomic<bool> is_wakeup_pending;
+        //! Is the loop thread busy-polling? The wakeup event isn't
+        //! written then, the thread checks is_wakeup_pending by itself.
+        std::atomic<bool> is_spinning;
+        //! How long to busy-poll before sleeping (microseconds),
+        //! 0 to never busy-poll.
+        std::atomic<uint32_t> busy_poll_us;
+
+        //! mutex for the timer wheel
+        std::mutex mutex_timers;
+        //! The wheel buckets, one per millisecond.
+        std::vector<Timer*> wheel;
+        //! The last processed moment of the wheel.
+        uint64_t wheel_time = 0;
+        //! The moment the kernel timer is armed for, 0 if disarmed.
+        uint64_t armed_time = 0;
+        //! Amount of started timers.
+        uint32_t timers_amount = 0;
+        //! The kernel timer firing the wheel.
+        int timer_fd = -1;
+        //! The watcher of the kernel timer.
+        Watcher timer_watcher;
+
+        //! mutex for tasks
+        std::mutex mutex_tasks;
+        //! The tasks to run in the loop thread.
+        std::vector<std::function<void()>> tasks;
+        //! The watchers to invoke in the loop thread.
+        std::vector<Watcher*> notified;
+
+        //! Must the loop thread stop?
+        std::atomic<bool> to_stop;
+        //! Amount of connections attached to the loop.
+        std::atomic<uint32_t> load;
+
+        //! The CPU the loop thread is pinned to, negative if floating.
+        int32_t cpu;
+
+        //! The loop thread.
+        std::thread *loop_thread = 0;
+
+        //! Loop thread function.
+        static void LoopThreadFunc(EventLoop *loop);
+        //! Run the loop using epoll.
+        void RunEpoll();
+        //! Run the loop using io_uring.
+        void RunIoUring();
+        //! Busy-poll epoll for the budget.
+        /*! \return The amount of ready events (0 if only tasks are
+         *          pending), -1 if nothing came and it's time to sleep.
+         */
+        int SpinEpoll(epoll_event *events);
+        //! Busy-poll the io_uring completions for the budget.
+        /*! \return false if nothing came and it's time to sleep. */
+        bool SpinIoUring();
+        //! Stop busy-polling.
+        /*! \return true if a wakeup came meanwhile, so the loop must
+         *          not sleep.
+         */
+        bool StopSpinning();
+        //! Wakeup event callback.
+        static void WakeupFunc(Watcher *w, uint32_t events);
+        //! Kernel timer callback, fires the expired timers.
+        static void TimerFunc(Watcher *w, uint32_t events);
+
+        //! Invoke the notified watchers and run all the posted tasks.
+        void RunTasks();
+        //! Wake the loop thread up, unless called from it.
+        void Wake();
+        //! Write the wakeup event, unless it's written already.
+        void WriteWakeup();
+
+        //! Schedule the slot operations update.
+        //! \warning mutex_slots must be locked.
+        void MarkDirty(uint32_t slot);
+        //! Arm and cancel the operations of the changed slots.
+        void FlushSlots();
+        //! Process one io_uring completion.
+        void ProcessCqe(uint64_t user_data, int32_t res, uint32_t flags);
+
+        //! Put the timer to the bucket of its deadline
+        //! (or of the farthest moment the wheel covers).
+        //! \warning mutex_timers must be locked.
+        void LinkTimer(Timer *t);
+        //! Take the timer out of its bucket.
+        //! \warning mutex_timers must be locked.
+        void UnlinkTimer(Timer *t);
+        //! Arm the kernel timer for the earliest non-empty bucket.
+        //! \warning mutex_timers must be locked.
+        void ArmTimerFd();
+    public:
+        //! Create the epoll or io_uring instance and start the loop thread.
+        /*!
+            \param backend the preferred backend. If io_uring can't be
+                   set up (old kernel, forbidden by seccomp), epoll is used.
+            \param cpu the CPU to pin the loop thread to, negative to
+                   leave it floating. The receive buffers are touched
+                   first by the loop thread, so they come from the NUMA
+                   node of the CPU.
+        */
+        explicit EventLoop(uint8_t backend = IoBackendEpoll, int32_t cpu = -1);
+
+        //! Get the backend in use.
+        uint8_t GetBackend();
+
+        //! Get the CPU the loop thread is pinned to, negative if floating.
+        int32_t GetCpu();
+
+        //! Set the busy-poll budget.
+        /*! MT-Safe. Before going to sleep the loop thread keeps
+         *  checking the descriptors and the posted tasks without
+         *  blocking for up to the budget. That saves the wakeup latency
+         *  at the cost of a CPU core spinning meanwhile.
+         *  \param us the budget in microseconds, 0 to turn it off
+         */
+        void SetBusyPoll(uint32_t us);
+        //! Get the busy-poll budget in microseconds.
+        uint32_t GetBusyPoll();
+
+        //! Start monitoring the file descriptor.
+        /*! MT-Safe.
+         *  \param w the watcher with callback and owner set
+         *  \param fd the file descriptor to monitor
+         *  \param events epoll events to wait for
+         *  \return true on success.
+         */
+        bool Add(Watcher *w, int fd, uint32_t events);
+        //! Change the events the watcher is interested in.
+        /*! MT-Safe. Does nothing if the events are not changed. */
+        bool Modify(Watcher *w, uint32_t events);
+        //! Stop monitoring the file descriptor.
+        /*! The watcher is not invoked anymore, even if it is ready
+         *  in the batch that is being processed right now or notified.
+         *  \warning Must be called from the loop thread.
+         */
+        void Remove(Watcher *w);
+        //! Invoke the watcher in the loop thread.
+        /*! MT-Safe. The watcher needs no file descriptor, its callback
+         *  is called with no events after the current batch of ready
+         *  watchers is processed. Notifications that come before the
+         *  watcher is invoked are merged, and the loop thread is woken
+         *  up once for everything notified or posted meanwhile.
+         *  \warning The watcher must stay valid until it's invoked or
+         *           removed.
+         */
+        void Notify(Watcher *w);
+
+        //! Start the timer or change its deadline.
+        /*! MT-Safe. The callback is called in the loop thread once
+         *  the deadline comes, then the timer is stopped.
+         *  \param t the timer with callback and owner set
+         *  \param deadline the moment (Utils::GetMonotonicMS())
+         */
+        void StartTimer(Timer *t, uint64_t deadline);
+        //! Postpone the started timer.
+        /*! MT-Safe and cheap: only the deadline is stored, the wheel
+         *  notices it when the old deadline comes. Use StartTimer() to
+         *  make the deadline earlier.
+         */
+        static void PostponeTimer(Timer *t, uint64_t deadline) {
+            t->deadline.store(deadline, std::memory_order_relaxed);
+        }
+        //! Stop the timer.
+        /*! MT-Safe. If called from the loop thread, the callback is
+         *  not called anymore, even if the timer is expired in the
+         *  batch that is being processed right now.
+         */
+        void StopTimer(Timer *t);
+
+        //! Run the task in the loop thread.
+        /*! MT-Safe. The task is run after the current batch of
+         *  ready watchers and the notified watchers are processed.
+         */
+        void Post(std::function<void()> task);
+
+        //! Check if called from the loop thread.
+        bool IsInLoopThread();
+
+        //! Mark that one more connection is served by this loop.
+        void Attach();
+        //! Mark that one connection is not served by this loop anymore.
+        void Detach();
+        //! Get the amount of connections served by this loop.
+        uint32_t GetLoad();
+
+        //! Stop the loop thread and close the descriptors.
+        /*! \warning Watchers and timers must be removed beforehand. */
+        ~EventLoop();
+    };
+}
+
+#endif
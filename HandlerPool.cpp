@@ -0,0 +1,68 @@
+#include "HandlerPool.hpp"
+#include "Utils.hpp"
+
+void DowowNetwork::HandlerPool::WorkerThreadFunc(HandlerPool *pool, int32_t cpu) {
+    Utils::SetThreadCpu(cpu);
+
+    std::unique_lock<std::mutex> __mt(pool->mutex_tasks);
+
+    while (true) {
+        // wait for a task
+        while (!pool->tasks.size() && !pool->to_stop)
+            pool->tasks_cv.wait(__mt);
+
+        // nothing is left to do
+        if (!pool->tasks.size()) return;
+
+        // take the task
+        std::function<void()> task = pool->tasks.front();
+        pool->tasks.pop();
+
+        // run it unlocked
+        __mt.unlock();
+        task();
+        __mt.lock();
+    }
+}
+
+DowowNetwork::HandlerPool::HandlerPool(uint32_t threads, const std::vector<uint32_t>& cpus) {
+    // use all the cores (or the ones given)
+    if (!threads) threads = cpus.size();
+    if (!threads) threads = std::thread::hardware_concurrency();
+    // hardware_concurrency() may fail
+    if (!threads) threads = 1;
+
+    // start the workers
+    for (uint32_t i = 0; i < threads; ++i) {
+        int32_t cpu = cpus.size() ? cpus[i % cpus.size()] : -1;
+        this->threads.push_back(new std::thread(WorkerThreadFunc, this, cpu));
+    }
+}
+
+uint32_t DowowNetwork::HandlerPool::GetThreadsAmount() {
+    return threads.size();
+}
+
+void DowowNetwork::HandlerPool::Post(std::function<void()> task) {
+    mutex_tasks.lock();
+    tasks.push(task);
+    mutex_tasks.unlock();
+
+    // wake a worker up
+    tasks_cv.notify_one();
+}
+
+DowowNetwork::HandlerPool::~HandlerPool() {
+    // make the workers stop once the queue is empty
+    mutex_tasks.lock();
+    to_stop = true;
+    mutex_tasks.unlock();
+    tasks_cv.notify_all();
+
+    // wait for them
+    for (auto t : threads) {
+        t->join();
+        delete t;
+    }
+    threads.clear();
+}
@@ -0,0 +1,76 @@
+/*!
+    \file
+
+    This file defines the HandlerPool class.
+*/
+
+#ifndef __DOWOW_NETWORK__HANDLER_POOL_H_
+#define __DOWOW_NETWORK__HANDLER_POOL_H_
+
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace DowowNetwork {
+    //! A fixed set of threads running the request handlers.
+    /*!
+        By default the handlers run in the event loop thread of the
+        Connection, so a slow handler delays all the I/O of the
+        Connection (and of the other Connections served by the same
+        loop). When a HandlerPool is assigned, the handlers run in
+        the pool threads instead.
+
+        The Requests of the same Connection are still handled one
+        after another in the order they were received, the Requests
+        of different Connections are handled in parallel.
+
+        \warning
+            The HandlerPool must outlive all the Connections it serves.
+    */
+    class HandlerPool {
+    private:
+        //! The worker threads.
+        std::vector<std::thread*> threads;
+
+        //! mutex for the tasks
+        std::mutex mutex_tasks;
+        //! Notified when a task is posted or the pool is stopping.
+        std::condition_variable tasks_cv;
+        //! The tasks to run.
+        std::queue<std::function<void()>> tasks;
+        //! Must the workers stop?
+        bool to_stop = false;
+
+        //! Take the tasks and run them until stopped.
+        static void WorkerThreadFunc(HandlerPool *pool, int32_t cpu);
+    public:
+        //! Create the pool.
+        /*!
+            \param threads the amount of worker threads,
+                   0 for the amount of CPU cores (or of the CPUs
+                   below, if they're specified).
+            \param cpus the CPUs to pin the worker threads to, the i-th
+                   worker runs on cpus[i % cpus.size()]. Empty to leave
+                   the threads floating.
+        */
+        explicit HandlerPool(
+            uint32_t threads = 0,
+            const std::vector<uint32_t>& cpus = std::vector<uint32_t>());
+
+        //! Get the amount of worker threads.
+        uint32_t GetThreadsAmount();
+
+        //! Run the task in some worker thread.
+        /*! MT-Safe. */
+        void Post(std::function<void()> task);
+
+        //! Run the remaining tasks and stop the threads.
+        ~HandlerPool();
+    };
+}
+
+#endif
@@ -0,0 +1,20 @@
+/*!
+    \file
+
+    This file declares IoBackend enum.
+*/
+
+#ifndef __DOWOW_NETWORK__IO_BACKEND_H_
+#define __DOWOW_NETWORK__IO_BACKEND_H_
+
+#include <cstdint>
+
+namespace DowowNetwork {
+    /// The mechanism an EventLoop waits for I/O with
+    enum IoBackend : uint8_t {
+        IoBackendEpoll = 0,         ///< epoll readiness notifications
+        IoBackendIoUring = 1        ///< io_uring completions, falls back to epoll
+    };
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "IoUring.hpp"
+
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// atomic ring index accessors
+#define LoadAcquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define StoreRelease(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+void DowowNetwork::IoUring::Destroy() {
+    if (buffers) munmap(buffers, buffers_amount * buffer_size);
+    if (sqes) munmap(sqes, sqes_size);
+    if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    if (sq_ring) munmap(sq_ring, sq_ring_size);
+    if (ring_fd != -1) close(ring_fd);
+
+    buffers = 0;
+    sqes = 0;
+    cq_ring = 0;
+    sq_ring = 0;
+    ring_fd = -1;
+}
+
+DowowNetwork::IoUring::IoUring(uint32_t entries, uint32_t buffers_amount, uint32_t buffer_size) :
+    buffers_amount(buffers_amount),
+    buffer_size(buffer_size)
+{
+    // create the ring
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    // not supported or forbidden
+    if (ring_fd == -1) return;
+
+    // the single mapping is required (Linux 5.4+)
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        Destroy();
+        return;
+    }
+
+    // map the rings
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (cq_ring_size > sq_ring_size) sq_ring_size = cq_ring_size;
+    cq_ring_size = sq_ring_size;
+    sq_ring = mmap(
+        0, sq_ring_size,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        sq_ring = 0;
+        Destroy();
+        return;
+    }
+    cq_ring = sq_ring;
+
+    // map the submission entries
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes_map = mmap(
+        0, sqes_size,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd, IORING_OFF_SQES);
+    if (sqes_map == MAP_FAILED) {
+        Destroy();
+        return;
+    }
+    sqes = reinterpret_cast<io_uring_sqe*>(sqes_map);
+
+    // ring fields
+    char *sq = reinterpret_cast<char*>(sq_ring);
+    sq_head = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    char *cq = reinterpret_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sq_entries = params.sq_entries;
+
+    // allocate the provided buffers
+    void *buffers_map = mmap(
+        0, buffers_amount * buffer_size,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+        -1, 0);
+    if (buffers_map == MAP_FAILED) {
+        Destroy();
+        return;
+    }
+    buffers = reinterpret_cast<char*>(buffers_map);
+
+    // give all the buffers to the kernel (Linux 5.7+)
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = buffers_amount;
+    sqe->addr = reinterpret_cast<uint64_t>(buffers);
+    sqe->len = buffer_size;
+    sqe->buf_group = buffer_group;
+    sqe->off = 0;
+    sqe->user_data = internal_user_data;
+    Submit(1);
+
+    // check the result
+    io_uring_cqe *cqe = PeekCqe();
+    int32_t provide_res = cqe ? cqe->res : -1;
+    if (cqe) PopCqe();
+    if (provide_res < 0) {
+        Destroy();
+        return;
+    }
+}
+
+bool DowowNetwork::IoUring::IsValid() {
+    return ring_fd != -1;
+}
+
+io_uring_sqe* DowowNetwork::IoUring::GetSqe() {
+    // the ring is full, make some space
+    if (*sq_tail + to_submit - LoadAcquire(sq_head) >= sq_entries)
+        Submit();
+
+    uint32_t index = (*sq_tail + to_submit) & *sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    to_submit++;
+
+    return sqe;
+}
+
+void DowowNetwork::IoUring::Submit(uint32_t wait_for) {
+    // publish the prepared entries
+    StoreRelease(sq_tail, *sq_tail + to_submit);
+
+    uint32_t submitting = to_submit;
+    to_submit = 0;
+
+    // nothing to do
+    if (!submitting && !wait_for) return;
+
+    syscall(
+        __NR_io_uring_enter,
+        ring_fd,
+        submitting,
+        wait_for,
+        wait_for ? IORING_ENTER_GETEVENTS : 0,
+        0,
+        0);
+}
+
+void DowowNetwork::IoUring::Poll() {
+    // publish the prepared entries
+    StoreRelease(sq_tail, *sq_tail + to_submit);
+
+    uint32_t submitting = to_submit;
+    to_submit = 0;
+
+    syscall(
+        __NR_io_uring_enter,
+        ring_fd,
+        submitting,
+        0,
+        IORING_ENTER_GETEVENTS,
+        0,
+        0);
+}
+
+io_uring_cqe* DowowNetwork::IoUring::PeekCqe() {
+    uint32_t head = *cq_head;
+    // no completions
+    if (head == LoadAcquire(cq_tail)) return 0;
+    return &cqes[head & *cq_mask];
+}
+
+void DowowNetwork::IoUring::PopCqe() {
+    StoreRelease(cq_head, *cq_head + 1);
+}
+
+const char* DowowNetwork::IoUring::GetBuffer(uint16_t id) {
+    return buffers + static_cast<size_t>(id) * buffer_size;
+}
+
+void DowowNetwork::IoUring::RecycleBuffer(uint16_t id) {
+    // provided back with the next submission,
+    // the completion is posted only if it fails (Linux 5.17+)
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = reinterpret_cast<uint64_t>(GetBuffer(id));
+    sqe->len = buffer_size;
+    sqe->buf_group = buffer_group;
+    sqe->off = id;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = internal_user_data;
+}
+
+DowowNetwork::IoUring::~IoUring() {
+    Destroy();
+}
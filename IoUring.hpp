@@ -0,0 +1,114 @@
+/*!
+    \file
+
+    This file defines the IoUring class, a thin wrapper of the io_uring
+    system calls used by the EventLoop.
+*/
+
+#ifndef __DOWOW_NETWORK__IO_URING_H_
+#define __DOWOW_NETWORK__IO_URING_H_
+
+#include <cstdint>
+#include <linux/io_uring.h>
+
+namespace DowowNetwork {
+    //! The io_uring instance with a group of provided buffers.
+    /*!
+        Not MT-Safe, the instance is used by the loop thread only.
+    */
+    class IoUring {
+    private:
+        //! The ring file descriptor.
+        int ring_fd = -1;
+
+        //! The mapped submission ring.
+        void *sq_ring = 0;
+        //! The size of the mapped submission ring.
+        uint32_t sq_ring_size = 0;
+        //! The mapped completion ring, may be equal to sq_ring.
+        void *cq_ring = 0;
+        //! The size of the mapped completion ring.
+        uint32_t cq_ring_size = 0;
+        //! The mapped submission entries.
+        io_uring_sqe *sqes = 0;
+        //! The size of the mapped submission entries.
+        uint32_t sqes_size = 0;
+
+        //! Submission ring fields.
+        uint32_t *sq_head = 0, *sq_tail = 0, *sq_mask = 0, *sq_array = 0;
+        //! Completion ring fields.
+        uint32_t *cq_head = 0, *cq_tail = 0, *cq_mask = 0;
+        //! Completion entries.
+        io_uring_cqe *cqes = 0;
+
+        //! The amount of submission entries.
+        uint32_t sq_entries = 0;
+        //! Entries prepared but not submitted yet.
+        uint32_t to_submit = 0;
+
+        //! The memory of the provided buffers.
+        char *buffers = 0;
+        //! The amount of provided buffers.
+        uint32_t buffers_amount = 0;
+        //! The size of each provided buffer.
+        uint32_t buffer_size = 0;
+
+        //! Unmap everything and close the ring.
+        void Destroy();
+    public:
+        //! The provided buffers group ID.
+        static const uint16_t buffer_group = 0;
+        //! The user data of the entries submitted by the ring itself.
+        /*! Their completions must be ignored. */
+        static const uint64_t internal_user_data = UINT64_MAX;
+
+        //! Set up the ring.
+        /*!
+            \param entries the amount of submission entries
+            \param buffers_amount the amount of provided buffers
+            \param buffer_size the size of each provided buffer
+
+            Check IsValid() to know if the kernel supports everything.
+        */
+        IoUring(uint32_t entries, uint32_t buffers_amount, uint32_t buffer_size);
+
+        //! Check if the ring and the provided buffers are set up.
+        bool IsValid();
+
+        //! Get a zeroed submission entry.
+        /*! Submits the prepared entries if the ring is full. */
+        io_uring_sqe* GetSqe();
+
+        //! Submit the prepared entries and wait for completions.
+        /*!
+            \param wait_for the amount of completions to wait for
+        */
+        void Submit(uint32_t wait_for = 0);
+
+        //! Submit the prepared entries and reap what's completed,
+        //! never waiting.
+        /*! Unlike Submit() it always enters the kernel, so the
+         *  completions that need the thread's context are posted.
+         */
+        void Poll();
+
+        //! Get the next completion.
+        /*! \return The completion or null-pointer if there's none.
+         *  \warning Call PopCqe() when it's processed.
+         */
+        io_uring_cqe* PeekCqe();
+        //! Mark the completion returned by PeekCqe() as processed.
+        void PopCqe();
+
+        //! Get the provided buffer by its ID.
+        const char* GetBuffer(uint16_t id);
+        //! Give the provided buffer back to the kernel.
+        /*! Takes effect with the next Submit(). */
+        void RecycleBuffer(uint16_t id);
+
+        //! Close the ring.
+        ~IoUring();
+    };
+}
+
+#endif
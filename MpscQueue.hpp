@@ -0,0 +1,86 @@
+/*!
+    \file
+
+    This file defines the MpscQueue class.
+*/
+
+#ifndef __DOWOW_NETWORK__MPSC_QUEUE_H_
+#define __DOWOW_NETWORK__MPSC_QUEUE_H_
+
+#include <atomic>
+
+namespace DowowNetwork {
+    //! A lock-free multi-producer single-consumer queue.
+    /*!
+        Push() may be called from any threads at once, it's one atomic
+        exchange and never waits for the other producers or the consumer.
+        Pop() and IsEmpty() must be called by one thread at a time (the
+        consumer).
+
+        The elements are linked nodes (D. Vyukov's algorithm). The last
+        popped node stays as the stub, so the producers and the consumer
+        never touch the same node unless the queue is empty.
+
+        A Pop() that runs while a producer is between the exchange and
+        the linking sees the queue as empty up to that element. So the
+        producer must notify the consumer after Push() returns.
+    */
+    template<typename T> class MpscQueue {
+    private:
+        struct Node {
+            std::atomic<Node*> next;
+            T value;
+
+            Node() : next(0), value() {}
+        };
+
+        //! The last pushed node (producers).
+        std::atomic<Node*> head;
+        //! The last popped node, the stub (the consumer).
+        Node *tail;
+    public:
+        MpscQueue() {
+            tail = new Node();
+            head.store(tail, std::memory_order_relaxed);
+        }
+
+        //! Add the value to the end. MT-Safe.
+        void Push(const T& value) {
+            Node *n = new Node();
+            n->value = value;
+            Node *prev = head.exchange(n, std::memory_order_acq_rel);
+            prev->next.store(n, std::memory_order_release);
+        }
+
+        //! Take the value from the front.
+        /*! \return false if the queue is empty. */
+        bool Pop(T& value) {
+            Node *next = tail->next.load(std::memory_order_acquire);
+            if (!next) return false;
+
+            // the next one becomes the stub
+            value = next->value;
+            next->value = T();
+            delete tail;
+            tail = next;
+            return true;
+        }
+
+        //! Check if the queue is empty.
+        bool IsEmpty() {
+            return !tail->next.load(std::memory_order_acquire);
+        }
+
+        //! Delete the nodes (not the values).
+        /*! \warning The producers must be finished. */
+        ~MpscQueue() {
+            while (tail) {
+                Node *next = tail->next.load(std::memory_order_relaxed);
+                delete tail;
+                tail = next;
+            }
+        }
+    };
+}
+
+#endif
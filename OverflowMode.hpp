@@ -0,0 +1,24 @@
+/*!
+    \file
+
+    This file declares OverflowMode enum.
+*/
+
+#ifndef __DOWOW_NETWORK__OVERFLOW_MODE_H_
+#define __DOWOW_NETWORK__OVERFLOW_MODE_H_
+
+#include <cstdint>
+
+namespace DowowNetwork {
+    /// What Push() does when the send queue is above the high watermark
+    /*!
+        \sa Connection::SetSendWatermarks().
+    */
+    enum OverflowMode : uint8_t {
+        OverflowModeBlock = 0,  ///< wait until the queue is drained to the low watermark
+        OverflowModeFail = 1,   ///< refuse the request as if not connected
+        OverflowModeDrop = 2    ///< accept the request and throw it away
+    };
+}
+
+#endif
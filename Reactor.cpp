@@ -0,0 +1,47 @@
+#include "Reactor.hpp"
+
+#include <thread>
+
+DowowNetwork::Reactor::Reactor(
+    uint32_t threads,
+    uint8_t io_backend,
+    const std::vector<uint32_t>& cpus)
+{
+    // use all the cores (or the ones given)
+    if (!threads) threads = cpus.size();
+    if (!threads) threads = std::thread::hardware_concurrency();
+    // hardware_concurrency() may fail
+    if (!threads) threads = 1;
+
+    // start the loops
+    for (uint32_t i = 0; i < threads; ++i) {
+        int32_t cpu = cpus.size() ? cpus[i % cpus.size()] : -1;
+        loops.push_back(new EventLoop(io_backend, cpu));
+    }
+}
+
+uint32_t DowowNetwork::Reactor::GetThreadsAmount() {
+    return loops.size();
+}
+
+void DowowNetwork::Reactor::SetBusyPoll(uint32_t us) {
+    for (auto l : loops) l->SetBusyPoll(us);
+}
+
+uint8_t DowowNetwork::Reactor::GetIoBackend() {
+    return loops[0]->GetBackend();
+}
+
+DowowNetwork::EventLoop* DowowNetwork::Reactor::GetLoop() {
+    EventLoop *result = loops[0];
+    for (auto l : loops) {
+        if (l->GetLoad() < result->GetLoad())
+            result = l;
+    }
+    return result;
+}
+
+DowowNetwork::Reactor::~Reactor() {
+    for (auto l : loops) delete l;
+    loops.clear();
+}
@@ -0,0 +1,70 @@
+/*!
+    \file
+
+    This file defines the Reactor class.
+*/
+
+#ifndef __DOWOW_NETWORK__REACTOR_H_
+#define __DOWOW_NETWORK__REACTOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "EventLoop.hpp"
+
+namespace DowowNetwork {
+    //! A fixed set of event loops shared by many connections.
+    /*!
+        By default every Connection has its own polling thread. When a
+        Reactor is assigned, the Connection is served by one of the
+        Reactor's loops instead, so the amount of threads doesn't depend
+        on the amount of connections.
+
+        \warning
+            The Reactor must outlive all the Connections it serves.
+            Handlers of the Connections served by the same loop are
+            executed one after another, so a handler must never wait
+            for another Connection to stop.
+    */
+    class Reactor {
+    private:
+        //! The event loops.
+        std::vector<EventLoop*> loops;
+    public:
+        //! Create the reactor.
+        /*!
+            \param threads the amount of event loop threads,
+                   0 for the amount of CPU cores (or of the CPUs
+                   below, if they're specified).
+            \param io_backend the preferred backend of the loops
+            \param cpus the CPUs to pin the loop threads to, the i-th
+                   loop runs on cpus[i % cpus.size()]. Empty to leave
+                   the threads floating.
+        */
+        explicit Reactor(
+            uint32_t threads = 0,
+            uint8_t io_backend = IoBackendEpoll,
+            const std::vector<uint32_t>& cpus = std::vector<uint32_t>());
+
+        //! Get the backend actually used by the loops.
+        uint8_t GetIoBackend();
+
+        //! Get the amount of event loop threads.
+        uint32_t GetThreadsAmount();
+
+        //! Set the busy-poll budget of all the loops.
+        /*! MT-Safe. \sa EventLoop::SetBusyPoll(). */
+        void SetBusyPoll(uint32_t us);
+
+        //! Get the loop to serve a new connection.
+        /*! MT-Safe.
+         *  \return The least loaded loop.
+         */
+        EventLoop* GetLoop();
+
+        //! Stop all the loops.
+        ~Reactor();
+    };
+}
+
+#endif
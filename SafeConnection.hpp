@@ -1,26 +1,90 @@
+/*!
+    \file
+
+    This file defines the SafeConnection class.
+*/
+
 #ifndef __DOWOW_NETWORK__SAFE_CONNECTION_H_
 #define __DOWOW_NETWORK__SAFE_CONNECTION_H_
 
 #include "Connection.hpp"
 
 namespace DowowNetwork {
-    /// Wrapper for connection.
-    /// It prevents the connection from being deleted.
+    /// Handle to a connection.
+    /*!
+        It prevents the connection from being finalized while held.
+        The handle is a value: copying it adds a reference, moving it
+        passes the reference over, nothing is heap-allocated.
+        An empty handle (the default one or a moved-from one) refers
+        to no connection and converts to false.
+    */
     class SafeConnection {
         private:
-            Connection *c;
+            Connection *c = 0;
         public:
-            SafeConnection() = delete;
-            inline SafeConnection(Connection *c) : c(c) {
-                c->IncreaseRefs();
+            //! Construct an empty handle.
+            inline SafeConnection() {}
+
+            //! Construct a handle holding a reference to the connection.
+            inline explicit SafeConnection(Connection *c) : c(c) {
+                if (c) c->IncreaseRefs();
+            }
+
+            inline SafeConnection(const SafeConnection& other) : c(other.c) {
+                if (c) c->IncreaseRefs();
+            }
+
+            inline SafeConnection(SafeConnection&& other) : c(other.c) {
+                other.c = 0;
+            }
+
+            inline SafeConnection& operator=(const SafeConnection& other) {
+                // referenced before the release for the self-assignment
+                Connection *oc = other.c;
+                if (oc) oc->IncreaseRefs();
+                Reset();
+                c = oc;
+                return *this;
+            }
+
+            inline SafeConnection& operator=(SafeConnection&& other) {
+                if (this != &other) {
+                    Reset();
+                    c = other.c;
+                    other.c = 0;
+                }
+                return *this;
+            }
+
+            //! Release the reference, the handle becomes empty.
+            inline void Reset() {
+                if (c) c->DecreaseRefs();
+                c = 0;
+            }
+
+            //! Get the connection, null-pointer if empty.
+            inline Connection* Get() const {
+                return c;
+            }
+
+            inline explicit operator bool() const {
+                return c;
+            }
+
+            inline Connection* operator->() const {
+                return c;
+            }
+
+            inline Connection& operator*() const {
+                return *c;
             }
 
-            inline Connection& operator()() {
+            inline Connection& operator()() const {
                 return *c;
             }
 
             inline ~SafeConnection() {
-                c->DecreaseRefs();
+                Reset();
             }
     };
 }
@@ -0,0 +1,26 @@
+/*!
+    \file
+
+    This file declares SendPriority enum.
+*/
+
+#ifndef __DOWOW_NETWORK__SEND_PRIORITY_H_
+#define __DOWOW_NETWORK__SEND_PRIORITY_H_
+
+#include <cstdint>
+
+namespace DowowNetwork {
+    /// The lane of the send queue a Request is pushed to
+    /*!
+        The Request being sent is always finished, then the next one
+        is taken from the highest priority lane that isn't empty.
+    */
+    enum SendPriority : uint8_t {
+        SendPriorityControl = 0,    ///< keep-alives, cancellations, small replies
+        SendPriorityNormal = 1,     ///< the default
+        SendPriorityBulk = 2,       ///< large transfers, sent when nothing else is queued
+        SendPrioritiesAmount = 3    ///< the amount of the lanes (not a priority)
+    };
+}
+
+#endif
@@ -1,6 +1,6 @@
 #include <sys/socket.h>
 #include <sys/types.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
 
 #include <sys/un.h>
@@ -13,160 +13,208 @@
 #include <errno.h>
 
 #include <thread>
-#include <algorithm>
 
 #include <iostream>
 
 #include "Utils.hpp"
 #include "Server.hpp"
 
-DowowNetwork::Connection* DowowNetwork::Server::AcceptOne() {
+DowowNetwork::Connection* DowowNetwork::Server::AcceptOne(Acceptor *a) {
     // accept
-    int temp_fd = accept4(socket_fd, 0, 0, 0);
-    // failed
+    // remark:  the aborted connections are skipped
+    int temp_fd;
+    do {
+        temp_fd = accept4(
+            a->socket_fd, 0, 0,
+            SOCK_NONBLOCK | SOCK_CLOEXEC);
+    } while (temp_fd == -1 && (errno == EINTR || errno == ECONNABORTED));
+    // none left (EAGAIN) or failed
     if (temp_fd == -1) return 0;
 
     // create a connection
-    Connection *conn = new Connection(temp_fd);
-
-    // call the handler if set
-    if (GetConnectedHandler()) {
-        (*GetConnectedHandler())(this, conn);
-    }
+    // remark:  with many acceptors the accepting loop
+    //          serves the connection itself
+    // remark:  the socket isn't read until the 'connected'
+    //          handler is called, see AcceptFunc()
+    int32_t cpu = -1;
+    if (!reactor && loop_cpus.size())
+        cpu = loop_cpus[next_loop_cpu++ % loop_cpus.size()];
+    Connection *conn = acceptors.size() > 1 ?
+        new Connection(temp_fd, a->loop, false) :
+        new Connection(temp_fd, reactor, io_backend, cpu, false);
+    conn->SetHandlerPool(handler_pool);
+    if (busy_poll_us) conn->SetBusyPoll(busy_poll_us);
 
     // success
     return conn;
 }
 
-void DowowNetwork::Server::ServerThreadFunc(Server *s) {
-    // free id for a new connection
-    uint32_t free_conn_id = 1;
+void DowowNetwork::Server::AcceptFunc(Watcher *w, uint32_t events) {
+    Acceptor *a = reinterpret_cast<Acceptor*>(w->owner);
+    Server *s = a->server;
 
-    // infinite loop
-    while (true) {
-        // whether should accept new clients
-        bool accept_new = true;
-        if (s->max_connections >= 0) {
-            accept_new =
-                static_cast<int32_t>(s->connections.size()) <
-                s->max_connections;
-        }
+    // lock
+    std::lock_guard<typeof(s->mutex_server)> __sm(s->mutex_server);
 
-        pollfd *pollfds = new pollfd[2 + s->connections.size()];
-        // server socket
-        pollfds[0].fd = accept_new ? s->socket_fd : -1;
-        pollfds[0].events = POLLIN;
-        // 'to_stop' event
-        pollfds[1].fd = s->to_stop_event;
-        pollfds[1].events = POLLIN;
-
-        // ask all connections for a 'closed' event
-        size_t i = 0;
-        for (auto c : s->connections) {
-            pollfds[2 + i].fd = c->GetStoppedEvent();
-            pollfds[2 + i].events = POLLIN;
-            ++i;
-        }
+    // accept all the pending clients (the socket is nonblocking)
+    // remark:  unless the shutdown is in progress or the limit is reached
+    while (!s->is_stopping && !s->IsFull()) {
+        Connection *new_conn = s->AcceptOne(a);
+        // nothing to accept
+        if (!new_conn) break;
+
+        // assign the id
+        new_conn->id = s->free_conn_id++;
+
+        // monitor the connection stop
+        Accepted *acc = new Accepted();
+        acc->acceptor = a;
+        acc->conn = new_conn;
+        acc->stopped_watcher.callback = StoppedFunc;
+        acc->stopped_watcher.owner = acc;
+        a->loop->Add(
+            &acc->stopped_watcher,
+            new_conn->GetStoppedEvent(),
+            EPOLLIN);
+
+        // add to the connections
+        s->connections[new_conn->id] = acc;
+        s->registry.Add(new_conn);
+
+        // call the handler in the connection loop thread, then start
+        // receiving, so the handler may set up the connection before
+        // the first request comes (or keep it paused)
+        // remark:  the connection isn't finalized (so it isn't deleted)
+        //          until it starts receiving
+        ConnectionHandler handler = s->GetConnectedHandler();
+        new_conn->GetLoop()->Post([s, new_conn, handler]() {
+            if (handler) (*handler)(s, new_conn);
+            new_conn->StartReceiving();
+        });
+    }
 
-        // poll events
-        poll(
-            pollfds,
-            2 + s->connections.size(),
-            -1);
+    // the limit might be reached
+    s->UpdateAccepting();
+}
 
-        // lock
-        std::lock_guard<typeof(s->mutex_server)> __sm(s->mutex_server);
-
-        // ***************************
-        // check if 'to_stop' occurred
-        // ***************************
-        if (pollfds[1].revents & POLLIN) {
-            // free pollfds memory
-            delete[] pollfds;
-            // break the thread loop
-            break;
-        }
+void DowowNetwork::Server::StoppedFunc(Watcher *w, uint32_t events) {
+    Accepted *acc = reinterpret_cast<Accepted*>(w->owner);
+    Server *s = acc->acceptor->server;
 
-        // ************************************
-        // check if some connections are closed
-        // ************************************
-        std::list<Connection*> deleted_conns;
-        i = 0;
-        for (auto c : s->connections) {
-            if (pollfds[2 + i++].revents & POLLIN) {
-                // call 'disconnected' handler
-                (*s->GetDisconnectedHandler())(s, c);
-                // delete the connection
-                delete c;
-                deleted_conns.push_back(c);
-            }
-        }
-        // remove deleted connections
-        for (auto c : deleted_conns)
-            s->connections.remove(c);
-
-        // ***********************
-        // check if new connection
-        // ***********************
-        if (pollfds[0].revents & POLLIN) {
-            // accept
-            Connection *new_conn = s->AcceptOne();
-            // not an error
-            if (new_conn) {
-                // assign the id
-                new_conn->id = free_conn_id++;
-                // add to the list of connections
-                s->connections.push_back(new_conn);
-            }
-        }
+    // lock
+    std::lock_guard<typeof(s->mutex_server)> __sm(s->mutex_server);
 
-        // *************************************
-        // no new connections, no deleted - quit
-        // *************************************
-        else if (!deleted_conns.size()) {
-            delete[] pollfds;
-            break;
-        }
+    // stop monitoring
+    acc->acceptor->loop->Remove(w);
+    // remove from the connections
+    s->connections.erase(acc->conn->id);
+    s->registry.Remove(acc->conn);
+
+    // call 'disconnected' handler (unless the server is stopping)
+    if (!s->is_stopping && s->GetDisconnectedHandler())
+        (*s->GetDisconnectedHandler())(s, acc->conn);
+    // count how the shutdown went
+    // remark:  drained right before the deadline counts as drained
+    if (s->is_stopping) {
+        if (acc->conn->IsDrained()) s->stop_report.drained++;
+        else if (acc->is_cut_off) s->stop_report.cut_off++;
+        else s->stop_report.failed++;
+    }
+    // delete the connection
+    delete acc->conn;
+    delete acc;
+
+    if (s->is_stopping) {
+        // the last connection might be gone
+        s->FinishStop();
+    } else {
+        // there might be a free place now
+        s->UpdateAccepting();
+    }
+}
 
-        // free memory
-        delete[] pollfds;
-        continue;
+void DowowNetwork::Server::StartAcceptors(const std::vector<int>& socket_fds) {
+    // reset the stopped event
+    Utils::ReadEventFd(stopped_event, 0);
+
+    // delete the acceptors of the previous run
+    DeleteAcceptors();
+
+    for (int fd : socket_fds) {
+        Acceptor *a = new Acceptor();
+        a->server = this;
+        a->socket_fd = fd;
+        a->loop = new EventLoop(io_backend, GetAcceptorCpu(acceptors.size()));
+        a->socket_watcher.callback = AcceptFunc;
+        a->socket_watcher.owner = a;
+        acceptors.push_back(a);
     }
 
-    // lock
-    std::lock_guard<typeof(s->mutex_server)> __sm(s->mutex_server);
+    // watch the listening sockets
+    for (auto a : acceptors)
+        a->loop->Add(&a->socket_watcher, a->socket_fd, 0);
+    UpdateAccepting();
+}
 
-    // force open connections to close
-    // make all the open connections close
-    for (auto c : s->connections) {
-        c->Disconnect(true);
-        c->WaitForStop(-1);
-        delete c;
+void DowowNetwork::Server::DeleteAcceptors() {
+    for (auto a : acceptors) {
+        delete a->loop;
+        delete a;
     }
-    s->connections.clear();
+    acceptors.clear();
+}
 
-    // close the server socket
-    close(s->socket_fd);
-    // close to_stop fd
-    close(s->to_stop_event);
-    
-    // clear
-    s->connections.clear();
+bool DowowNetwork::Server::IsFull() {
+    return
+        max_connections >= 0 &&
+        static_cast<int32_t>(connections.size()) >= max_connections;
+}
 
-    // notify about stop
-    Utils::WriteEventFd(s->stopped_event, 1);
+void DowowNetwork::Server::UpdateAccepting() {
+    // whether should accept new clients
+    bool accept_new = !IsFull();
+
+    for (auto a : acceptors)
+        a->loop->Modify(&a->socket_watcher, accept_new ? EPOLLIN : 0);
+}
+
+void DowowNetwork::Server::CloseAcceptor(Acceptor *a) {
+    // lock
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+
+    // stop accepting
+    a->loop->Remove(&a->socket_watcher);
+
+    // close the listening socket
+    close(a->socket_fd);
+    a->socket_fd = -1;
+
+    // the connections might be already gone
+    FinishStop();
+}
+
+void DowowNetwork::Server::FinishStop() {
+    // lock
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+
+    // not everything is closed yet
+    if (connections.size()) return;
+    for (auto a : acceptors)
+        if (a->socket_fd != -1) return;
 
     // UNIX socket - delete it
-    if (s->GetType() == SocketTypeUnix)
-        unlink(s->unix_socket_path.c_str());
+    if (GetType() == SocketTypeUnix)
+        unlink(unix_socket_path.c_str());
 
     // reset some data
-    s->socket_fd = -1;
-    s->to_stop_event = -1;
-    s->socket_type = SocketTypeUndefined;
+    is_stopping = false;
+    socket_type = SocketTypeUndefined;
+
+    // notify about stop
+    Utils::WriteEventFd(stopped_event, 1);
 }
 
-DowowNetwork::Server::Server() {
+DowowNetwork::Server::Server(uint8_t io_backend) : io_backend(io_backend) {
     stopped_event = eventfd(0, 0);
 }
 
@@ -179,7 +227,7 @@ bool DowowNetwork::Server::StartUnix(std::string path, bool dof) {
         return false;
 
     // try to create a socket
-    socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     // check if failed
     if (socket_fd == -1) return false;
 
@@ -223,12 +271,8 @@ bool DowowNetwork::Server::StartUnix(std::string path, bool dof) {
     socket_type = SocketTypeUnix;
     unix_socket_path = path;
 
-    // create eventfd
-    to_stop_event = eventfd(0, 0);
-
-    // start the thread
-    std::thread t(ServerThreadFunc, this);
-    t.detach();
+    // start accepting
+    StartAcceptors({ socket_fd });
 
     return true;
 }
@@ -244,21 +288,6 @@ bool DowowNetwork::Server::StartTcp(std::string ip, uint16_t port) {
     if (GetType() != SocketTypeUndefined)
         return false;
 
-    // try to create a socket
-    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    // check if failed
-    if (socket_fd == -1)
-        return false;
-
-    // allow reuse
-    int reuse_flag = 1;
-    setsockopt(
-        socket_fd,
-        SOL_SOCKET,
-        SO_REUSEADDR,
-        &reuse_flag,
-        sizeof(reuse_flag));
-
     // prepare socket address
     sockaddr_in addr;
     addr.sin_family = AF_INET;
@@ -266,25 +295,68 @@ bool DowowNetwork::Server::StartTcp(std::string ip, uint16_t port) {
     // parse the IP address
     if (!inet_aton(ip.c_str(), &addr.sin_addr)) {
         // invalid address
-        close(socket_fd);
         return false;
     }
 
-    // bind
-    int bind_res = bind(
-        socket_fd,
-        reinterpret_cast<sockaddr*>(&addr),
-        sizeof(addr));
-    if (bind_res == -1) {
-        // failed to bind
-        close(socket_fd);
-        return false;
+    // the listening sockets
+    std::vector<int> socket_fds;
+    for (uint32_t i = 0; i < acceptors_amount; ++i) {
+        // try to create a socket
+        int socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        // check if failed
+        if (socket_fd == -1)
+            break;
+        socket_fds.push_back(socket_fd);
+
+        // allow reuse
+        int reuse_flag = 1;
+        setsockopt(
+            socket_fd,
+            SOL_SOCKET,
+            SO_REUSEADDR,
+            &reuse_flag,
+            sizeof(reuse_flag));
+        // let the kernel spread the connections across the sockets
+        if (acceptors_amount > 1) {
+            setsockopt(
+                socket_fd,
+                SOL_SOCKET,
+                SO_REUSEPORT,
+                &reuse_flag,
+                sizeof(reuse_flag));
+
+            // prefer the acceptor on the CPU receiving the packets
+            int cpu = GetAcceptorCpu(i);
+            if (cpu >= 0) {
+                setsockopt(
+                    socket_fd,
+                    SOL_SOCKET,
+                    SO_INCOMING_CPU,
+                    &cpu,
+                    sizeof(cpu));
+            }
+        }
+
+        // bind
+        int bind_res = bind(
+            socket_fd,
+            reinterpret_cast<sockaddr*>(&addr),
+            sizeof(addr));
+        if (bind_res == -1) {
+            // failed to bind
+            break;
+        }
+
+        // set the socket to be listening
+        if (listen(socket_fd, SOMAXCONN) == -1) {
+            // fail
+            break;
+        }
     }
 
-    // set the socket to be listening
-    if (listen(socket_fd, SOMAXCONN) == -1) {
-        // fail
-        close(socket_fd);
+    // some socket failed
+    if (socket_fds.size() != acceptors_amount) {
+        for (int fd : socket_fds) close(fd);
         return false;
     }
 
@@ -293,16 +365,61 @@ bool DowowNetwork::Server::StartTcp(std::string ip, uint16_t port) {
     tcp_socket_address = be32toh(addr.sin_addr.s_addr);
     tcp_socket_port = port;
 
-    // create eventfd
-    to_stop_event = eventfd(0, 0);
-
-    // start the thread
-    std::thread t(ServerThreadFunc, this);
-    t.detach();
+    // start accepting
+    StartAcceptors(socket_fds);
 
     return true;
 }
 
+void DowowNetwork::Server::SetAcceptorsAmount(uint32_t amount) {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+
+    // use all the cores
+    if (!amount) amount = std::thread::hardware_concurrency();
+    // hardware_concurrency() may fail
+    if (!amount) amount = 1;
+
+    acceptors_amount = amount;
+}
+
+uint32_t DowowNetwork::Server::GetAcceptorsAmount() {
+    return acceptors_amount;
+}
+
+void DowowNetwork::Server::SetAcceptorCpus(const std::vector<uint32_t>& cpus) {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    acceptor_cpus = cpus;
+}
+
+std::vector<uint32_t> DowowNetwork::Server::GetAcceptorCpus() {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    return acceptor_cpus;
+}
+
+void DowowNetwork::Server::SetLoopCpus(const std::vector<uint32_t>& cpus) {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    loop_cpus = cpus;
+}
+
+std::vector<uint32_t> DowowNetwork::Server::GetLoopCpus() {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    return loop_cpus;
+}
+
+void DowowNetwork::Server::SetBusyPoll(uint32_t us) {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    busy_poll_us = us;
+}
+
+uint32_t DowowNetwork::Server::GetBusyPoll() {
+    return busy_poll_us;
+}
+
+int32_t DowowNetwork::Server::GetAcceptorCpu(uint32_t i) {
+    if (!acceptor_cpus.size()) return -1;
+    return acceptor_cpus[i % acceptor_cpus.size()];
+}
+
 uint32_t DowowNetwork::Server::GetTcpIp() {
     return tcp_socket_address;
 }
@@ -322,49 +439,129 @@ uint8_t DowowNetwork::Server::GetType() {
 }
 
 void DowowNetwork::Server::SetMaxConnections(int32_t c) {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
     max_connections = c;
+
+    // reevaluate the limit
+    UpdateAccepting();
 }
 
 int32_t DowowNetwork::Server::GetMaxConnections() {
     return max_connections;
 }
 
-DowowNetwork::SafeConnection *DowowNetwork::Server::GetConnection(std::string tag) {
-    auto it = std::find_if(
-        connections.begin(),
-        connections.end(),
-        [&](Connection *c) {
-            return c->tag == tag;
-        });
+void DowowNetwork::Server::SetReactor(Reactor *reactor) {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    this->reactor = reactor;
+}
 
-    if (it == connections.end()) return 0;
+DowowNetwork::Reactor* DowowNetwork::Server::GetReactor() {
+    return reactor;
+}
 
-    return new SafeConnection(*it);
+void DowowNetwork::Server::SetHandlerPool(HandlerPool *pool) {
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    handler_pool = pool;
 }
 
-DowowNetwork::SafeConnection *DowowNetwork::Server::GetConnection(uint32_t id) {
-    auto it = std::find_if(
-        connections.begin(),
-        connections.end(),
-        [&](Connection *c) {
-            return c->id == id;
-        });
+DowowNetwork::HandlerPool* DowowNetwork::Server::GetHandlerPool() {
+    return handler_pool;
+}
 
-    if (it == connections.end()) return 0;
+DowowNetwork::SafeConnection DowowNetwork::Server::GetConnection(std::string tag) {
+    return registry.Find(tag);
+}
+
+DowowNetwork::SafeConnection DowowNetwork::Server::GetConnection(uint32_t id) {
+    return registry.Find(id);
+}
+
+void DowowNetwork::Server::SetTag(Connection *conn, std::string tag) {
+    registry.SetTag(conn, tag);
+}
 
-    return new SafeConnection(*it);
+std::vector<DowowNetwork::SafeConnection> DowowNetwork::Server::GetConnections() {
+    return registry.Snapshot();
 }
 
 void DowowNetwork::Server::Stop(int timeout) {
-    // check if server is not started
-    if (GetType() == SocketTypeUndefined) return;
+    {
+        // lock
+        std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+
+        // check if server is not started
+        if (GetType() == SocketTypeUndefined) return;
+
+        // start the shutdown once
+        if (!is_stopping) {
+            is_stopping = true;
 
-    // make the thread stop
-    Utils::WriteEventFd(to_stop_event, 1);
+            // force open connections to close,
+            // the server is stopped once they're all gone
+            for (auto& i : connections)
+                i.second->conn->Disconnect(true);
+
+            // close the listening sockets
+            for (auto a : acceptors)
+                a->loop->Post([this, a]() { CloseAcceptor(a); });
+        }
+    }
 
     WaitForStop(timeout);
 }
 
+DowowNetwork::StopReport DowowNetwork::Server::StopGracefully(int timeout) {
+    bool is_started = false;
+    {
+        // lock
+        std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+
+        // check if server is not started
+        if (GetType() == SocketTypeUndefined) return StopReport();
+
+        // start the shutdown once
+        if (!is_stopping) {
+            is_stopping = true;
+            is_started = true;
+            stop_report = StopReport();
+
+            // make all the connections send the rest and close,
+            // the server is stopped once they're all gone
+            for (auto& i : connections)
+                i.second->conn->Disconnect(false);
+
+            // close the listening sockets
+            for (auto a : acceptors)
+                a->loop->Post([this, a]() { CloseAcceptor(a); });
+        }
+    }
+
+    // started by someone else
+    if (!is_started) return StopReport();
+
+    // not drained in time
+    if (!Utils::SelectRead(stopped_event, timeout)) {
+        // lock
+        std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+
+        // cut the rest off
+        // remark:  the stopping ones are finished already,
+        //          just not deleted yet
+        for (auto& i : connections) {
+            Accepted *acc = i.second;
+            if (acc->conn->GetState() == ConnectionStateDraining)
+                acc->is_cut_off = true;
+            acc->conn->Disconnect(true);
+        }
+    }
+
+    WaitForStop(-1);
+
+    // everyone is counted by now
+    std::lock_guard<typeof(mutex_server)> __sm(mutex_server);
+    return stop_report;
+}
+
 void DowowNetwork::Server::WaitForStop(int timeout) {
     // not started
     if (GetType() == SocketTypeUndefined) return;
@@ -377,6 +574,11 @@ DowowNetwork::Server::~Server() {
     // stop
     Stop(-1);
 
+    // stop the acceptor loops
+    mutex_server.lock();
+    DeleteAcceptors();
+    mutex_server.unlock();
+
     // close the stopped eventfd
     close(stopped_event);
 }
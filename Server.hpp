@@ -8,13 +8,16 @@
 #define __DOWOW_NETWORK__SERVER_H_
 
 #include <string>
-#include <list>
+#include <vector>
+#include <unordered_map>
 
 #include <sys/eventfd.h>
 #include <mutex>
 
 #include "Connection.hpp"
+#include "Reactor.hpp"
 #include "SafeConnection.hpp"
+#include "ConnectionRegistry.hpp"
 #include "Request.hpp"
 #include "SocketType.hpp"
 
@@ -24,14 +27,59 @@ namespace DowowNetwork {
 
     typedef void (*ConnectionHandler)(Server *server, Connection *conn);
 
+    //! The outcome of Server::StopGracefully().
+    struct StopReport {
+        //! Amount of the connections closed after sending everything.
+        uint32_t drained = 0;
+        //! Amount of the connections closed forcibly at the deadline.
+        uint32_t cut_off = 0;
+        //! Amount of the connections closed by an error (reset by
+        //! the peer, broken) before everything was sent.
+        uint32_t failed = 0;
+    };
+
     class Server {
     private:
-        // server socket
-        int socket_fd = -1;
-        // accepted clients
-        std::list<Connection*> connections;
+        //! A listening socket with the loop accepting on it.
+        struct Acceptor {
+            //! The server that owns the acceptor.
+            Server *server;
+            //! The listening socket, -1 if closed.
+            int socket_fd = -1;
+            //! The loop accepting the clients and monitoring their stop.
+            EventLoop *loop = 0;
+            //! The listening socket watcher.
+            Watcher socket_watcher;
+        };
+
+        //! An accepted connection monitored by the server.
+        struct Accepted {
+            //! The acceptor that accepted the connection.
+            Acceptor *acceptor;
+            //! The connection itself.
+            Connection *conn;
+            //! The watcher of the connection 'stopped' event.
+            Watcher stopped_watcher;
+            //! Is it disconnected forcibly at the drain deadline?
+            bool is_cut_off = false;
+        };
+
+        // the acceptors (one per listening socket)
+        std::vector<Acceptor*> acceptors;
+        // amount of SO_REUSEPORT acceptors for TCP
+        uint32_t acceptors_amount = 1;
+        // accepted clients by their ids
+        std::unordered_map<uint32_t, Accepted*> connections;
+        //! The index for the lookups, doesn't need mutex_server.
+        ConnectionRegistry registry;
+        // free id for a new connection
+        uint32_t free_conn_id = 1;
         // maximum amount of connected clients, negative for unlimited
         int32_t max_connections = -1;
+        // is the shutdown in progress?
+        bool is_stopping = false;
+        // the outcome of the shutdown, counted as the connections stop
+        StopReport stop_report;
 
         // socket type (undefined if server is not running)
         uint8_t socket_type = SocketTypeUndefined; 
@@ -45,35 +93,130 @@ namespace DowowNetwork {
 
         //! 'stopped' event.
         //! Occurs when the server is stopped.
-        //! Being created only when the shutdown is requested.
         int stopped_event = -1;
-        //! 'to_stop' event.
-        //! Occurs when the server shutdown is requested.
-        int to_stop_event = -1;
 
         // mutex for any operations
         std::recursive_mutex mutex_server;
 
+        //! The reactor serving the accepted connections.
+        //! Null-pointer for a thread per connection.
+        Reactor *reactor = 0;
+        //! The pool running the handlers of the accepted connections.
+        //! Null-pointer to run them in the event loop threads.
+        HandlerPool *handler_pool = 0;
+        //! The backend of the acceptor loops and the connections'
+        //! own loops.
+        uint8_t io_backend;
+        //! The CPUs of the acceptor loops, empty if floating.
+        std::vector<uint32_t> acceptor_cpus;
+        //! The CPUs of the connections' own loops, empty if floating.
+        std::vector<uint32_t> loop_cpus;
+        //! The index in loop_cpus for the next connection.
+        uint32_t next_loop_cpu = 0;
+        //! The busy-poll budget of the accepted connections.
+        uint32_t busy_poll_us = 0;
+
         //! Handler for new connections.
-        //! Called right after the polling thread for
-        //! connection is started.
-        ConnectionHandler connected_handler;
+        //! Called in the connection loop thread
+        //! before the connection starts receiving.
+        ConnectionHandler connected_handler = 0;
         //! Handler for disconnection.
         //! Called
-        ConnectionHandler disconnected_handler;
+        ConnectionHandler disconnected_handler = 0;
 
         /// Accept one client.
-        Connection* AcceptOne();
+        /*! \return The connection (not receiving yet) or
+         *          null-pointer if none is pending. */
+        Connection* AcceptOne(Acceptor *a);
+
+        //! The listening socket is readable.
+        static void AcceptFunc(Watcher *w, uint32_t events);
+        //! The connection is stopped.
+        static void StoppedFunc(Watcher *w, uint32_t events);
 
-        static void ServerThreadFunc(Server *server);
+        //! Get the CPU of the i-th acceptor, negative if floating.
+        int32_t GetAcceptorCpu(uint32_t i);
+        //! Start accepting on the listening sockets.
+        void StartAcceptors(const std::vector<int>& socket_fds);
+        //! Delete the acceptors of the previous run.
+        void DeleteAcceptors();
+        //! Check if the connections limit is reached.
+        bool IsFull();
+        //! Accept only if the connections limit isn't reached.
+        void UpdateAccepting();
+        //! Close the listening socket of the acceptor.
+        //! \warning Must be called from the acceptor loop thread.
+        void CloseAcceptor(Acceptor *a);
+        //! Notify about stop if everything is closed.
+        void FinishStop();
     public:
         /// Server constructor.
-        Server();
+        /*!
+            \param io_backend the backend of the acceptor loops and
+                   of the connections' own polling threads
+            \sa IoBackend.
+        */
+        explicit Server(uint8_t io_backend = IoBackendEpoll);
 
         bool StartUnix(std::string socket_path, bool delete_old_file = true);
         std::string GetUnixPath();
 
         bool StartTcp(std::string ip, uint16_t port);
+
+        /// Set the amount of TCP listening sockets.
+        /*!
+            If more than one, StartTcp() binds that many sockets to the
+            same port with SO_REUSEPORT, each accepting in its own loop
+            thread. The kernel spreads the incoming connections across
+            them and every loop serves the connections it accepted, so
+            the reactor is not used. UNIX servers always have one.
+            Takes effect on the next start.
+
+            \param amount the amount of sockets, 0 for the amount
+                   of CPU cores.
+        */
+        void SetAcceptorsAmount(uint32_t amount);
+        /// Get the amount of TCP listening sockets.
+        uint32_t GetAcceptorsAmount();
+
+        /// Set the CPUs to pin the acceptor loops to.
+        /*!
+            The i-th acceptor runs on cpus[i % cpus.size()]. With many
+            TCP listening sockets each socket also gets SO_INCOMING_CPU,
+            so the kernel hands a connection to the acceptor on the CPU
+            that received its packets. Takes effect on the next start.
+
+            \param cpus the CPU indexes, empty to leave the loops floating
+        */
+        void SetAcceptorCpus(const std::vector<uint32_t>& cpus);
+        /// Get the CPUs of the acceptor loops.
+        std::vector<uint32_t> GetAcceptorCpus();
+
+        /// Set the CPUs to pin the accepted connections' own loops to.
+        /*!
+            The connections get the CPUs in turn. Not used with a reactor
+            (pin it by its constructor) nor with many acceptors (the
+            connections share the acceptor loop then). The receive
+            buffers and the received requests are allocated by the
+            loop thread, so they come from the NUMA node of its CPU.
+            Affects the connections accepted after the call.
+
+            \param cpus the CPU indexes, empty to leave the loops floating
+        */
+        void SetLoopCpus(const std::vector<uint32_t>& cpus);
+        /// Get the CPUs of the accepted connections' own loops.
+        std::vector<uint32_t> GetLoopCpus();
+
+        /// Set the busy-poll budget of the accepted connections.
+        /*!
+            Affects the connections accepted after the call.
+            \sa Connection::SetBusyPoll().
+
+            \param us the budget in microseconds, 0 to turn it off
+        */
+        void SetBusyPoll(uint32_t us);
+        /// Get the busy-poll budget of the accepted connections.
+        uint32_t GetBusyPoll();
         uint32_t GetTcpIp();
         std::string GetTcpIpString();
         uint16_t GetTcpPort();
@@ -83,8 +226,74 @@ namespace DowowNetwork {
         void SetMaxConnections(int32_t c);
         int32_t GetMaxConnections();
 
-        SafeConnection *GetConnection(std::string tag);
-        SafeConnection *GetConnection(uint32_t id);
+        /// Set the reactor to serve the accepted connections.
+        /*!
+            Affects the connections accepted after the call.
+            Null-pointer (default) makes each connection use
+            its own polling thread.
+
+            \warning The reactor must outlive the server.
+        */
+        void SetReactor(Reactor *reactor);
+        /// Get the reactor serving the accepted connections.
+        Reactor* GetReactor();
+
+        /// Set the pool to run the handlers of the accepted connections.
+        /*!
+            Affects the connections accepted after the call.
+            Null-pointer (default) makes the handlers run in the
+            event loop threads.
+
+            \warning The pool must outlive the server.
+            \sa Connection::SetHandlerPool().
+        */
+        void SetHandlerPool(HandlerPool *pool);
+        /// Get the pool running the handlers of the accepted connections.
+        HandlerPool* GetHandlerPool();
+
+        /// Get the connection by its tag.
+        /*!
+            MT-Safe, takes no server-wide lock. Only the tags set by
+            SetTag() are indexed.
+
+            \return the handle, empty if there's no such connection
+                    or it's being stopped.
+        */
+        SafeConnection GetConnection(std::string tag);
+        /// Get the connection by its ID.
+        /*!
+            MT-Safe, takes no server-wide lock.
+
+            \return the handle, empty if there's no such connection
+                    or it's being stopped.
+        */
+        SafeConnection GetConnection(uint32_t id);
+
+        /// Set the tag of the accepted connection.
+        /*!
+            Makes the connection findable by GetConnection(tag).
+            If many connections share a tag, the last tagged one is found.
+            Can be called from the 'connected' handler.
+        */
+        void SetTag(Connection *conn, std::string tag);
+
+        /// Get the handles to all the accepted connections.
+        /*!
+            The snapshot keeps the connections alive and can be used
+            without any lock held, the connections accepted later
+            are not in it.
+        */
+        std::vector<SafeConnection> GetConnections();
+
+        /// Call the function for every accepted connection.
+        /*!
+            The function gets a SafeConnection& and may copy it to keep
+            the connection. Nothing is allocated, but a part of the
+            index is locked meanwhile, so the function should not block.
+        */
+        template<typename F> void ForEachConnection(F f) {
+            registry.ForEach(f);
+        }
 
         /// Set the 'connected' handler.
         inline void SetConnectedHandler(ConnectionHandler handler) {
@@ -108,7 +317,24 @@ namespace DowowNetwork {
         }
 
         //! Close the server.
+        /*! The connections are disconnected forcibly, all at once.
+         *  \param timeout seconds to wait for the stop, negative for infinity
+         */
         void Stop(int timeout = 0);
+        //! Close the server gracefully.
+        /*!
+            Stops accepting and disconnects all the connections
+            gracefully at once: each one sends the rest of its send
+            queue and stops. The ones still sending at the deadline are
+            disconnected forcibly. Returns once the server is stopped.
+
+            \param timeout seconds for all the connections to drain,
+                   negative for infinity
+            \return How many connections are drained, cut off and
+                    failed, all zeros if the server isn't started or is
+                    stopping already.
+        */
+        StopReport StopGracefully(int timeout = 10);
 
         //! Wait for server to stop.
         void WaitForStop(int timeout = -1);
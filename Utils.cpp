@@ -1,6 +1,8 @@
 #include "Utils.hpp"
 
 #include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
 #include <sys/poll.h>
 #include <sys/timerfd.h>
 #include <time.h>
@@ -43,3 +45,33 @@ void DowowNetwork::Utils::SetTimerFdTimeout(int fd, time_t seconds) {
     timerfd_settime(fd, 0, &new_timer, 0);
 }
 
+uint64_t DowowNetwork::Utils::GetMonotonicMS() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t DowowNetwork::Utils::GetMonotonicUS() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void DowowNetwork::Utils::SetTimerFdDeadline(int fd, uint64_t ms) {
+    itimerspec new_timer {
+        { 0, 0 },                                       // interval
+        { static_cast<time_t>(ms / 1000),
+          static_cast<long>(ms % 1000) * 1000000 }      // expiration
+    };
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &new_timer, 0);
+}
+
+bool DowowNetwork::Utils::SetThreadCpu(int32_t cpu) {
+    if (cpu < 0) return true;
+    if (cpu >= CPU_SETSIZE) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
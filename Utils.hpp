@@ -50,6 +50,31 @@ namespace DowowNetwork {
 
         /// Set the timer expiration time.
         void SetTimerFdTimeout(int fd, time_t seconds);
+
+        /// Get the CLOCK_MONOTONIC time in milliseconds.
+        uint64_t GetMonotonicMS();
+
+        /// Get the CLOCK_MONOTONIC time in microseconds.
+        uint64_t GetMonotonicUS();
+
+        /// Set the timer expiration moment.
+        /*!
+            \param fd the CLOCK_MONOTONIC timer
+            \param ms the moment returned by GetMonotonicMS(),
+                   0 to disarm the timer
+        */
+        void SetTimerFdDeadline(int fd, uint64_t ms);
+
+        /// Pin the calling thread to the CPU.
+        /*!
+            The memory the thread touches first is then allocated
+            from the NUMA node of the CPU (the default Linux policy).
+
+            \param cpu the CPU index, negative to leave the thread
+                   floating
+            \return false if the CPU can't be used.
+        */
+        bool SetThreadCpu(int32_t cpu);
     };
 };
 
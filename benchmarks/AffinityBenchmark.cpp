@@ -0,0 +1,159 @@
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// The port to use.
+const uint16_t port = 23061;
+// get_mempolicy() flags: return the node of the page at the address.
+const unsigned long mpol_f_node = 1 << 0, mpol_f_addr = 1 << 1;
+
+// The NUMA node of every CPU.
+vector<int> cpu_nodes;
+
+// Read the topology, every CPU is on node 0 if there's no NUMA.
+void ReadTopology() {
+    uint32_t cpus = thread::hardware_concurrency();
+    cpu_nodes.assign(cpus ? cpus : 1, 0);
+    for (int node = 0; node < 64; ++node) {
+        ifstream list("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+        if (!list) continue;
+        // e.g. "0-7,16-23"
+        string range;
+        while (getline(list, range, ',')) {
+            size_t dash = range.find('-');
+            uint32_t first = stoul(range.substr(0, dash));
+            uint32_t last = dash == string::npos ? first : stoul(range.substr(dash + 1));
+            for (uint32_t c = first; c <= last && c < cpu_nodes.size(); ++c)
+                cpu_nodes[c] = node;
+        }
+    }
+}
+
+// Get the node of the page holding the address, -1 if unknown.
+int GetPageNode(const void *p) {
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, 0, 0, p, mpol_f_node | mpol_f_addr))
+        return -1;
+    return node;
+}
+
+// Requests handled, and the ones whose memory is on another node.
+atomic<uint64_t> handled(0), remote(0);
+
+void HandlerEcho(Connection *c, Request *r) {
+    int cpu = sched_getcpu();
+    int node = GetPageNode(r);
+    if (cpu >= 0 && node >= 0 && uint32_t(cpu) < cpu_nodes.size() &&
+        cpu_nodes[cpu] != node)
+    {
+        remote++;
+    }
+    handled++;
+
+    c->Push(*r);
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("echo", HandlerEcho);
+    c->Push(Request("hello"));
+}
+
+// Run the echo load, print the throughput and the cross-node share.
+bool Run(bool is_pinned, uint32_t clients_amount, uint32_t requests) {
+    // the server loops: one per CPU, in order of the nodes
+    vector<uint32_t> cpus;
+    if (is_pinned) {
+        for (int node = 0; node < 64; ++node) {
+            for (uint32_t c = 0; c < cpu_nodes.size(); ++c)
+                if (cpu_nodes[c] == node) cpus.push_back(c);
+        }
+    }
+    Reactor server_reactor(cpu_nodes.size(), IoBackendEpoll, cpus);
+    Reactor client_reactor;
+
+    Server server;
+    server.SetReactor(&server_reactor);
+    server.SetAcceptorCpus(cpus);
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartTcp("127.0.0.1", port)) {
+        cout << "Failed to start the server" << endl;
+        return false;
+    }
+
+    vector<Client*> clients;
+    for (uint32_t i = 0; i < clients_amount; ++i) {
+        clients.push_back(new Client());
+        clients.back()->SetReactor(&client_reactor);
+        if (!clients.back()->ConnectTcp("127.0.0.1", port, 5)) {
+            cout << "Failed to connect" << endl;
+            return false;
+        }
+        delete clients.back()->Pull(5000);
+    }
+
+    handled = 0;
+    remote = 0;
+    auto begin = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (auto client : clients) {
+        threads.emplace_back([client, requests]() {
+            for (uint32_t i = 0; i < requests; ++i)
+                delete client->Pull(5000);
+        });
+        for (uint32_t i = 0; i < requests; ++i)
+            client->Push(Request("echo"));
+    }
+    for (auto& t : threads) t.join();
+    auto end = chrono::steady_clock::now();
+
+    double seconds = chrono::duration<double>(end - begin).count();
+    cout << (is_pinned ? "pinned  " : "floating") << "\t"
+         << uint64_t(handled / seconds) << "\t\t"
+         << 100.0 * remote / (handled ? handled.load() : 1) << endl;
+
+    for (auto client : clients) {
+        client->Disconnect(true, true);
+        delete client;
+    }
+    server.Stop(-1);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (string(argv[1]) == "--help" || string(argv[1]) == "-h")) {
+        cout << "Compares the floating and the pinned server threads" << endl;
+        cout << "    " << argv[0] << " [clients] [requests per client]" << endl;
+        return 0;
+    }
+
+    // Arguments.
+    uint32_t clients_amount = argc > 1 ? stoul(argv[1]) : 16;
+    uint32_t requests = argc > 2 ? stoul(argv[2]) : 20000;
+
+    ReadTopology();
+    int nodes = 0;
+    for (int n : cpu_nodes) nodes = max(nodes, n + 1);
+    cout << cpu_nodes.size() << " CPUs on " << nodes << " NUMA node(s)" << endl;
+
+    cout << "threads\t\trequests/s\tcross-node requests, %" << endl;
+    if (!Run(false, clients_amount, requests)) return 1;
+    if (!Run(true, clients_amount, requests)) return 1;
+
+    return 0;
+}
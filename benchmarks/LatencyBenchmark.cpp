@@ -0,0 +1,99 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkLatencyBenchmark.sock";
+// The port to use.
+const uint16_t port = 23062;
+
+void HandlerPing(Connection *c, Request *r) {
+    // respond with the same ID
+    Request pong("pong");
+    pong.SetId(r->GetId());
+    c->Push(pong, 0, false);
+
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("ping", HandlerPing);
+    c->Push(Request("hello"));
+}
+
+// Measure the round trips, print p50/p99 in microseconds.
+bool Run(bool is_tcp, uint32_t busy_poll_us, uint32_t round_trips) {
+    Server server;
+    server.SetBusyPoll(busy_poll_us);
+    server.SetConnectedHandler(HandlerConnected);
+    bool is_started = is_tcp ?
+        server.StartTcp("127.0.0.1", port) :
+        server.StartUnix(socket_path);
+    if (!is_started) {
+        cout << "Failed to start the server" << endl;
+        return false;
+    }
+
+    Client client;
+    client.SetBusyPoll(busy_poll_us);
+    bool is_connected = is_tcp ?
+        client.ConnectTcp("127.0.0.1", port, 5) :
+        client.ConnectUnix(socket_path, 5);
+    if (!is_connected) {
+        cout << "Failed to connect" << endl;
+        return false;
+    }
+    delete client.Pull(5000);
+
+    vector<double> rtts;
+    rtts.reserve(round_trips);
+    for (uint32_t i = 0; i < round_trips; ++i) {
+        auto begin = chrono::steady_clock::now();
+        Request *pong = client.Push(Request("ping"), 5);
+        auto end = chrono::steady_clock::now();
+        if (!pong) {
+            cout << "No response" << endl;
+            return false;
+        }
+        delete pong;
+        rtts.push_back(chrono::duration<double, micro>(end - begin).count());
+    }
+
+    sort(rtts.begin(), rtts.end());
+    cout << (is_tcp ? "TCP " : "UNIX") << "\t" << busy_poll_us << "\t\t"
+         << rtts[rtts.size() / 2] << "\t"
+         << rtts[rtts.size() * 99 / 100] << endl;
+
+    client.Disconnect(true, true);
+    server.Stop(-1);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (string(argv[1]) == "--help" || string(argv[1]) == "-h")) {
+        cout << "Measures the round trip with and without busy-polling" << endl;
+        cout << "    " << argv[0] << " [busy-poll budget, us] [round trips]" << endl;
+        return 0;
+    }
+
+    // Arguments.
+    uint32_t budget = argc > 1 ? stoul(argv[1]) : 50;
+    uint32_t round_trips = argc > 2 ? stoul(argv[2]) : 20000;
+
+    cout << "socket\tbusy-poll, us\tp50, us\tp99, us" << endl;
+    for (bool is_tcp : { false, true }) {
+        if (!Run(is_tcp, 0, round_trips)) return 1;
+        if (!Run(is_tcp, budget, round_trips)) return 1;
+    }
+
+    return 0;
+}
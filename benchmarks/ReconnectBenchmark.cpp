@@ -0,0 +1,90 @@
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// The port to use.
+const uint16_t port = 23060;
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (string(argv[1]) == "--help" || string(argv[1]) == "-h")) {
+        cout << "Measures how fast the clients reconnect after a server restart" << endl;
+        cout << "    " << argv[0] << " [acceptors] [clients] [connecting threads]" << endl;
+        return 0;
+    }
+
+    // Arguments.
+    uint32_t acceptors = argc > 1 ? stoul(argv[1]) : 1;
+    uint32_t clients_amount = argc > 2 ? stoul(argv[2]) : 500;
+    uint32_t threads_amount = argc > 3 ? stoul(argv[3]) : 8;
+
+    Reactor server_reactor;
+    Reactor client_reactor;
+
+    Server server;
+    server.SetReactor(&server_reactor);
+    server.SetAcceptorsAmount(acceptors);
+
+    vector<Client*> clients;
+    for (uint32_t i = 0; i < clients_amount; ++i) {
+        clients.push_back(new Client());
+        clients.back()->SetReactor(&client_reactor);
+    }
+
+    // Connect all the clients using several threads.
+    auto connect_all = [&]() {
+        atomic<uint32_t> failed(0);
+        vector<thread> threads;
+        for (uint32_t t = 0; t < threads_amount; ++t) {
+            threads.emplace_back([&, t]() {
+                for (uint32_t i = t; i < clients_amount; i += threads_amount) {
+                    if (!clients[i]->ConnectTcp("127.0.0.1", port, 5))
+                        failed++;
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        return failed.load();
+    };
+
+    // The first run.
+    if (!server.StartTcp("127.0.0.1", port)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+    connect_all();
+
+    // Restart with everyone connected.
+    server.Stop(-1);
+    for (auto c : clients) c->WaitForStop(-1);
+    if (!server.StartTcp("127.0.0.1", port)) {
+        cout << "Failed to restart the server" << endl;
+        return 1;
+    }
+
+    // Measure the reconnection.
+    auto begin = chrono::steady_clock::now();
+    uint32_t failed = connect_all();
+    auto end = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(end - begin).count();
+
+    cout << "acceptors: " << server.GetAcceptorsAmount() << endl;
+    cout << "reconnected: " << clients_amount - failed
+         << " of " << clients_amount << endl;
+    cout << "time: " << seconds * 1000 << " ms" << endl;
+    cout << "rate: " << (clients_amount - failed) / seconds << " connections/s" << endl;
+
+    for (auto c : clients) delete c;
+    server.Stop(-1);
+
+    return 0;
+}
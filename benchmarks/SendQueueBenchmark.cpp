@@ -0,0 +1,121 @@
+#include "../MpscQueue.hpp"
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkSendQueueBenchmark.sock";
+
+// The send queue as it was: std::queue under a recursive mutex.
+class LockedQueue {
+private:
+    recursive_mutex mutex_sq;
+    queue<Request*> send_queue;
+public:
+    void Push(Request* r) {
+        lock_guard<recursive_mutex> __msq(mutex_sq);
+        send_queue.push(r);
+    }
+
+    bool Pop(Request*& r) {
+        lock_guard<recursive_mutex> __msq(mutex_sq);
+        if (!send_queue.size()) return false;
+        r = send_queue.front();
+        send_queue.pop();
+        return true;
+    }
+};
+
+// Push from the producers while one consumer pops, return pushes/s.
+template<typename Q> double Measure(uint32_t producers_amount, uint32_t pushes) {
+    Q queue;
+    Request dummy;
+    atomic<bool> to_start(false);
+
+    vector<thread> producers;
+    for (uint32_t p = 0; p < producers_amount; ++p) {
+        producers.emplace_back([&]() {
+            while (!to_start) {}
+            for (uint32_t i = 0; i < pushes; ++i) queue.Push(&dummy);
+        });
+    }
+
+    auto begin = chrono::steady_clock::now();
+    to_start = true;
+    uint64_t popped = 0;
+    Request *r;
+    while (popped < uint64_t(producers_amount) * pushes) {
+        if (queue.Pop(r)) popped++;
+    }
+    auto end = chrono::steady_clock::now();
+    for (auto& t : producers) t.join();
+
+    return popped / chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (string(argv[1]) == "--help" || string(argv[1]) == "-h")) {
+        cout << "Measures the send queue under many pushing threads" << endl;
+        cout << "    " << argv[0] << " [max producers] [pushes per producer]" << endl;
+        return 0;
+    }
+
+    // Arguments.
+    uint32_t max_producers = argc > 1 ? stoul(argv[1]) : 8;
+    uint32_t pushes = argc > 2 ? stoul(argv[2]) : 200000;
+
+    // The queues alone.
+    cout << "producers\tstd::queue+mutex\tMpscQueue\t(pushes/s)" << endl;
+    for (uint32_t p = 1; p <= max_producers; p *= 2) {
+        double locked = Measure<LockedQueue>(p, pushes);
+        double mpsc = Measure<MpscQueue<Request*>>(p, pushes);
+        cout << p << "\t\t" << uint64_t(locked) << "\t\t"
+             << uint64_t(mpsc) << "\t(x" << mpsc / locked << ")" << endl;
+    }
+
+    // Connection::Push() broadcasting to one connection.
+    Server server;
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+    Client client;
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+
+    uint32_t requests = pushes / 10;
+    cout << "producers\tConnection::Push()\t(pushes/s)" << endl;
+    for (uint32_t p = 1; p <= max_producers; p *= 2) {
+        Request r("_");
+        vector<thread> producers;
+        auto begin = chrono::steady_clock::now();
+        for (uint32_t t = 0; t < p; ++t) {
+            producers.emplace_back([&]() {
+                for (uint32_t i = 0; i < requests; ++i) client.Push(r);
+            });
+        }
+        for (auto& t : producers) t.join();
+        auto end = chrono::steady_clock::now();
+        cout << p << "\t\t" << uint64_t(p * requests /
+            chrono::duration<double>(end - begin).count()) << endl;
+    }
+
+    client.Disconnect(true, true);
+    server.Stop(-1);
+
+    return 0;
+}
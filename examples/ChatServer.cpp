@@ -78,14 +78,13 @@ void IssueMessage(string from, string to, string text) {
         // Send to everyone.
         for (auto i: participants) {
             // Get the associated connection
-            // Beware: the type is not Connection*, but SafeConnection*.
+            // Beware: the type is not Connection*, but SafeConnection,
+            // it keeps the connection alive until it goes out of scope.
             auto c = server.GetConnection(i.id);
             // this participant has been disconnected
             if (!c) continue;
             // issue
-            (*c)().Push(GenerateMessage(from, i.username, text));
-
-            delete c;
+            c->Push(GenerateMessage(from, i.username, text));
         }
     } else {
         cout << "[" << from << " -> " + to + "] " << text << endl;
@@ -95,13 +94,11 @@ void IssueMessage(string from, string to, string text) {
         if (!p) return;
 
         // get connection
-        SafeConnection *c = server.GetConnection(p->id);
+        SafeConnection c = server.GetConnection(p->id);
         // not found
         if (!c) return;
 
-        (*c)().Push(GenerateMessage(from, to, p->username));
-
-        delete c;
+        c->Push(GenerateMessage(from, to, p->username));
     }
 }
 
@@ -0,0 +1,101 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients connected at once.
+const int clients_amount = 32;
+// How long the 'connected' handler works.
+const long handler_ms = 100;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkAcceptTest.sock";
+
+// Amount of 'connected' handlers finished.
+atomic<int> handlers_finished(0);
+// Amount of connections with a zero id in the handler.
+atomic<int> zero_ids(0);
+
+void PingHandler(Connection *conn, Request *r) {
+    Request pong("pong");
+    pong.SetId(r->GetId());
+    conn->Push(pong, 0, false);
+    delete r;
+}
+
+void ConnectedHandler(Server *server, Connection *conn) {
+    if (!conn->id) zero_ids++;
+
+    // slow
+    SleepMS(handler_ms);
+
+    // the first request must not miss it
+    conn->SetHandlerNamed("ping", PingHandler);
+    handlers_finished++;
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(ConnectedHandler);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    // *******************************
+    // the handlers don't stall accept
+    // *******************************
+    vector<Client*> clients;
+    for (int i = 0; i < clients_amount; i++) clients.push_back(new Client());
+
+    uint64_t started = NowMS();
+    uint32_t connected = Client::ConnectUnixMany(clients, socket_path, 5);
+    if (connected != clients_amount) {
+        cout << "Connected " << connected << " clients" << endl;
+        return 1;
+    }
+
+    // the first request of each client is handled by the handler
+    // set in the 'connected' handler
+    for (auto c : clients) {
+        Request *response = c->Push(Request("ping"), 5);
+        if (!response || response->GetName() != "pong") {
+            cout << "The first request missed the handler" << endl;
+            return 1;
+        }
+        delete response;
+    }
+
+    // the handlers ran in parallel, not one by one in the acceptor
+    uint64_t elapsed = NowMS() - started;
+    if (handlers_finished != clients_amount ||
+        elapsed >= handler_ms * clients_amount / 2)
+    {
+        cout << "The handlers took " << elapsed << " ms" << endl;
+        return 1;
+    }
+
+    // the id is assigned before the handler is called
+    if (zero_ids) {
+        cout << "The handler got the connection without id" << endl;
+        return 1;
+    }
+
+    for (auto c : clients) {
+        c->Disconnect(true, true);
+        delete c;
+    }
+
+    server.Stop();
+    server.WaitForStop();
+
+    cout << "Success" << endl;
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients to connect per run.
+const int clients_amount = 32;
+// Amount of server restarts.
+const int runs_amount = 3;
+// The port to use.
+const uint16_t port = 23051;
+
+void HandlerPing(Connection *c, Request *r) {
+    // Respond with the incremented number.
+    Request pong("pong");
+    pong.Emplace<Value32S>("number", r->Get<Value32S>("number")->Get() + 1);
+    c->Push(pong);
+
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    // Setup the handler and let the client know it's set.
+    c->SetHandlerNamed("ping", HandlerPing);
+    c->Push(Request("hello"));
+}
+
+int main() {
+    Reactor client_reactor(2);
+
+    // Four listening sockets on the same port.
+    Server server;
+    server.SetAcceptorsAmount(4);
+    server.SetConnectedHandler(HandlerConnected);
+
+    for (int run = 0; run < runs_amount; ++run) {
+        if (!server.StartTcp("127.0.0.1", port)) {
+            cout << "Failed to start the server, run #" << run << endl;
+            return 1;
+        }
+
+        // Connect the clients.
+        vector<Client*> clients;
+        for (int i = 0; i < clients_amount; ++i) {
+            Client *c = new Client();
+            c->SetReactor(&client_reactor);
+            if (!c->ConnectTcp("127.0.0.1", port, 5)) {
+                cout << "Failed to connect client #" << i << endl;
+                return 1;
+            }
+            clients.push_back(c);
+        }
+
+        // Ping-pong.
+        for (int i = 0; i < clients_amount; ++i) {
+            Request *hello = PullFor(clients[i], 5000);
+            if (!hello) {
+                cout << "No greeting for client #" << i << endl;
+                return 1;
+            }
+            delete hello;
+
+            Request ping("ping");
+            ping.Emplace<Value32S>("number", i);
+            clients[i]->Push(ping);
+
+            Request *pong = PullFor(clients[i], 5000);
+            if (!pong || pong->Get<Value32S>("number")->Get() != i + 1) {
+                cout << "Invalid response for client #" << i << endl;
+                return 1;
+            }
+            delete pong;
+        }
+
+        // Stop with the clients still connected.
+        server.Stop(-1);
+        if (server.GetType() != SocketTypeUndefined) {
+            cout << "The server isn't stopped, run #" << run << endl;
+            return 1;
+        }
+
+        for (auto c : clients) delete c;
+        cout << "Run #" << run << " passed" << endl;
+    }
+
+    cout << "PASSED" << endl;
+    return 0;
+}
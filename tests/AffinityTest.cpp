@@ -0,0 +1,107 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+#include "../HandlerPool.hpp"
+#include "../Utils.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <iostream>
+
+#include <sched.h>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkAffinityTest.sock";
+
+// The CPU the last connected handler ran on.
+atomic<int> handler_cpu(-1);
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->Push(Request("hello"));
+}
+
+void HandlerWhere(Connection *c, Request *r) {
+    handler_cpu = sched_getcpu();
+    delete r;
+}
+
+int main() {
+    // the last CPU the process may use
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    uint32_t cpu = 0;
+    for (uint32_t c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &allowed)) cpu = c;
+
+    // ****************
+    // reactor and pool
+    // ****************
+    {
+        Reactor reactor(0, IoBackendEpoll, { cpu });
+        atomic<int> loop_cpu(-1);
+        reactor.GetLoop()->Post([&]() { loop_cpu = sched_getcpu(); });
+
+        HandlerPool pool(0, { cpu });
+        atomic<int> worker_cpu(-1);
+        pool.Post([&]() { worker_cpu = sched_getcpu(); });
+
+        for (int i = 0; i < 1000 && (loop_cpu < 0 || worker_cpu < 0); ++i) SleepMS(1);
+        if (reactor.GetThreadsAmount() != 1 || pool.GetThreadsAmount() != 1 ||
+            reactor.GetLoop()->GetCpu() != int32_t(cpu) ||
+            loop_cpu != int(cpu) || worker_cpu != int(cpu))
+        {
+            cout << "The reactor or the pool isn't pinned" << endl;
+            return 1;
+        }
+    }
+
+    // ***************************
+    // server and client own loops
+    // ***************************
+    Server server;
+    server.SetLoopCpus({ cpu });
+    server.SetAcceptorCpus({ cpu });
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    client.SetLoopCpu(cpu);
+    client.SetHandlerNamed("hello", HandlerWhere);
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    for (int i = 0; i < 5000 && handler_cpu < 0; ++i) SleepMS(1);
+
+    bool is_server_pinned = true;
+    server.ForEachConnection([&](SafeConnection& c) {
+        is_server_pinned = is_server_pinned && c->GetLoopCpu() == int32_t(cpu);
+    });
+    if (client.GetLoopCpu() != int32_t(cpu) || handler_cpu != int(cpu) ||
+        !is_server_pinned)
+    {
+        cout << "The own loops aren't pinned" << endl;
+        return 1;
+    }
+
+    // an unusable CPU is ignored
+    if (Utils::SetThreadCpu(CPU_SETSIZE)) {
+        cout << "Pinned to a nonexistent CPU" << endl;
+        return 1;
+    }
+
+    client.Disconnect(true, true);
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
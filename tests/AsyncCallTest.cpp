@@ -0,0 +1,149 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <atomic>
+#include <future>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of calls in flight at once.
+const int calls_amount = 2000;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkAsyncCallTest.sock";
+
+// Wait for the counter to reach the value.
+bool WaitFor(atomic<int>& counter, int value, int ms) {
+    for (int i = 0; i < ms && counter < value; ++i) SleepMS(1);
+    return counter >= value;
+}
+
+void HandlerSquare(Connection *c, Request *r) {
+    // Respond with the same ID.
+    Request result("result");
+    result.SetId(r->GetId());
+    int32_t number = r->Get<Value32S>("number")->Get();
+    result.Emplace<Value32S>("square", number * number);
+    c->Push(result, 0, false);
+
+    delete r;
+}
+
+void HandlerIgnore(Connection *c, Request *r) {
+    // No response at all.
+    delete r;
+}
+
+void HandlerDrop(Connection *c, Request *r) {
+    // Disconnect instead of responding.
+    c->Disconnect(true);
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("square", HandlerSquare);
+    c->SetHandlerNamed("ignore", HandlerIgnore);
+    c->SetHandlerNamed("drop", HandlerDrop);
+    c->Push(Request("hello"));
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    // The handlers are set once it's received.
+    Request *hello = client.Pull(5000);
+    if (!hello) {
+        cout << "No hello" << endl;
+        return 1;
+    }
+    delete hello;
+
+    // One thread makes all the calls at once.
+    atomic<int> completed(0), failed(0);
+    for (int i = 0; i < calls_amount; ++i) {
+        Request square("square");
+        square.Emplace<Value32S>("number", i);
+        client.PushAsync(square, 5, [i, &completed, &failed](Connection *c, Request *r) {
+            if (!r || r->Get<Value32S>("square")->Get() != i * i) failed++;
+            delete r;
+            completed++;
+        });
+    }
+    if (!WaitFor(completed, calls_amount, 5000) || failed) {
+        cout << "Calls completed: " << completed << ", failed: " << failed << endl;
+        return 1;
+    }
+
+    // The future form.
+    Request square("square");
+    square.Emplace<Value32S>("number", 12);
+    future<Request*> f = client.PushFuture(square, 5);
+    Request *result = f.get();
+    if (!result || result->Get<Value32S>("square")->Get() != 144) {
+        cout << "The future failed" << endl;
+        return 1;
+    }
+    delete result;
+
+    // No response: timed out.
+    long started = NowMS();
+    atomic<int> timed_out(0);
+    atomic<long> elapsed(0);
+    client.PushAsync(Request("ignore"), 1, [&](Connection *c, Request *r) {
+        if (!r) timed_out++;
+        delete r;
+        elapsed = NowMS() - started;
+    });
+    if (!WaitFor(timed_out, 1, 5000) || elapsed < 900 || elapsed > 3000) {
+        cout << "The call didn't time out properly: " << elapsed << " ms" << endl;
+        return 1;
+    }
+
+    // Disconnected while waiting infinitely.
+    atomic<int> cancelled(0);
+    for (int i = 0; i < 10; ++i) {
+        client.PushAsync(Request("ignore"), -1, [&](Connection *c, Request *r) {
+            if (!r) cancelled++;
+            delete r;
+        });
+    }
+    client.PushAsync(Request("drop"), -1, [&](Connection *c, Request *r) {
+        if (!r) cancelled++;
+        delete r;
+    });
+    if (!WaitFor(cancelled, 11, 5000)) {
+        cout << "The calls didn't fail on disconnection" << endl;
+        return 1;
+    }
+
+    // Not connected: completed at once.
+    client.WaitForStop(5);
+    bool is_called = false;
+    client.PushAsync(Request("square"), -1, [&](Connection *c, Request *r) {
+        is_called = !r;
+    });
+    if (!is_called) {
+        cout << "The call wasn't completed while disconnected" << endl;
+        return 1;
+    }
+
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of round trips per backend.
+const int round_trips = 2000;
+// The busy-poll budget, microseconds.
+const uint32_t budget = 100;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkBusyPollTest.sock";
+
+void HandlerPing(Connection *c, Request *r) {
+    Request pong("pong");
+    pong.SetId(r->GetId());
+    c->Push(pong, 0, false);
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("ping", HandlerPing);
+    c->Push(Request("hello"));
+}
+
+bool Run(uint8_t io_backend) {
+    Server server(io_backend);
+    server.SetBusyPoll(budget);
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return false;
+    }
+
+    Client client(io_backend);
+    client.SetBusyPoll(budget);
+    if (!client.ConnectUnix(socket_path, 5) || client.GetBusyPoll() != budget) {
+        cout << "Failed to connect" << endl;
+        return false;
+    }
+    delete client.Pull(5000);
+
+    // the responses come while the loops spin
+    for (int i = 0; i < round_trips; ++i) {
+        Request *pong = client.Push(Request("ping"), 5);
+        if (!pong) {
+            cout << "No response to " << i << endl;
+            return false;
+        }
+        delete pong;
+    }
+
+    // ... and once they sleep again
+    client.SetBusyPoll(0);
+    SleepMS(10);
+    Request *pong = client.Push(Request("ping"), 5);
+    if (!pong) {
+        cout << "No response after busy-polling" << endl;
+        return false;
+    }
+    delete pong;
+
+    client.Disconnect(true, true);
+    server.Stop(-1);
+    return true;
+}
+
+int main() {
+    if (!Run(IoBackendEpoll) || !Run(IoBackendIoUring)) return 1;
+
+    // *******************************************
+    // the tasks posted to a spinning loop are run
+    // *******************************************
+    Reactor reactor(1);
+    reactor.SetBusyPoll(1000 * 1000);
+    atomic<int> run(0);
+    for (int i = 0; i < 1000; ++i) {
+        reactor.GetLoop()->Post([&]() { run++; });
+        if (i % 100 == 0) SleepMS(1);
+    }
+    for (int i = 0; i < 1000 && run < 1000; ++i) SleepMS(1);
+    if (run != 1000) {
+        cout << "Run " << run << " tasks" << endl;
+        return 1;
+    }
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of threads calling at once.
+const int threads_amount = 8;
+// Amount of calls made by each thread.
+const int calls_amount = 200;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkCallTest.sock";
+
+void HandlerSquare(Connection *c, Request *r) {
+    // Respond with the same ID.
+    Request result("result");
+    result.SetId(r->GetId());
+    int32_t number = r->Get<Value32S>("number")->Get();
+    result.Emplace<Value32S>("square", number * number);
+    c->Push(result, 0, false);
+
+    delete r;
+}
+
+void HandlerIgnore(Connection *c, Request *r) {
+    // No response at all.
+    delete r;
+}
+
+void HandlerDrop(Connection *c, Request *r) {
+    // Disconnect instead of responding.
+    c->Disconnect(true);
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("square", HandlerSquare);
+    c->SetHandlerNamed("ignore", HandlerIgnore);
+    c->SetHandlerNamed("drop", HandlerDrop);
+    c->Push(Request("hello"));
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    // The handlers are set once it's received.
+    Request *hello = client.Pull(5000);
+    if (!hello) {
+        cout << "No hello" << endl;
+        return 1;
+    }
+    delete hello;
+
+    // Many calls in flight at once.
+    atomic<int> failed(0);
+    vector<thread> threads;
+    for (int t = 0; t < threads_amount; ++t) {
+        threads.push_back(thread([&client, &failed, t]() {
+            for (int i = 0; i < calls_amount; ++i) {
+                int32_t number = t * calls_amount + i;
+                Request square("square");
+                square.Emplace<Value32S>("number", number);
+
+                Request *result = client.Push(square, 5);
+                if (!result ||
+                    result->Get<Value32S>("square")->Get() != number * number)
+                {
+                    failed++;
+                }
+                delete result;
+            }
+        }));
+    }
+    for (auto& t : threads) t.join();
+    if (failed) {
+        cout << failed << " calls failed" << endl;
+        return 1;
+    }
+
+    // Nothing is left for Pull().
+    Request *left = client.Pull(0);
+    if (left) {
+        cout << "A response got to the receive queue" << endl;
+        return 1;
+    }
+
+    // No response: timed out.
+    long started = NowMS();
+    Request *result = client.Push(Request("ignore"), 1);
+    long elapsed = NowMS() - started;
+    if (result || elapsed < 900 || elapsed > 3000) {
+        cout << "The call didn't time out properly: " << elapsed << " ms" << endl;
+        return 1;
+    }
+
+    // Disconnected while waiting infinitely.
+    result = client.Push(Request("drop"), -1);
+    client.WaitForStop(5);
+    if (result || client.IsConnected()) {
+        cout << "The call didn't fail on disconnection" << endl;
+        return 1;
+    }
+
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
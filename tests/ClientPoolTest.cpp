@@ -0,0 +1,162 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../ClientPool.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of connections in the pool.
+const uint32_t pool_size = 4;
+// Amount of threads calling at once.
+const int threads_amount = 8;
+// Amount of calls made by each thread.
+const int calls_amount = 200;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkClientPoolTest.sock";
+// The port nobody listens on.
+const uint16_t closed_port = 23065;
+
+void HandlerSquare(Connection *c, Request *r) {
+    // Respond with the same ID.
+    Request result("result");
+    result.SetId(r->GetId());
+    int32_t number = r->Get<Value32S>("number")->Get();
+    result.Emplace<Value32S>("square", number * number);
+    c->Push(result, 0, false);
+
+    delete r;
+}
+
+void HandlerIgnore(Connection *c, Request *r) {
+    // No response at all.
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("square", HandlerSquare);
+    c->SetHandlerNamed("ignore", HandlerIgnore);
+    c->Push(Request("hello"));
+}
+
+// Wait for the handlers of the server side to be set.
+bool WaitForHello(ClientPool& pool) {
+    for (uint32_t i = 0; i < pool.GetSize(); ++i) {
+        Request *hello = pool.GetClient(i)->Pull(5000);
+        if (!hello) return false;
+        delete hello;
+    }
+    return true;
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    ClientPool pool(pool_size);
+    if (pool.IsStarted() || pool.GetConnectedAmount() != 0) {
+        cout << "The pool is connected before it's started" << endl;
+        return 1;
+    }
+    if (!pool.StartUnix(socket_path, 5) || pool.StartUnix(socket_path, 5) ||
+        pool.GetConnectedAmount() != pool_size || !WaitForHello(pool))
+    {
+        cout << "Failed to start the pool" << endl;
+        return 1;
+    }
+
+    // ****************************************
+    // the calls are spread over the least busy
+    // ****************************************
+    atomic<int> ignored(0);
+    for (uint32_t i = 0; i < pool_size * 2; ++i) {
+        pool.PushAsync(Request("ignore"), 60, [&](Connection *c, Request *r) {
+            ignored++;
+            delete r;
+        });
+    }
+    for (uint32_t i = 0; i < pool_size; ++i) {
+        if (pool.GetClient(i)->GetPendingCallsAmount() != 2) {
+            cout << "Client " << i << " has "
+                 << pool.GetClient(i)->GetPendingCallsAmount() << " calls" << endl;
+            return 1;
+        }
+    }
+
+    // ... from many threads
+    atomic<int> failed(0);
+    vector<thread> threads;
+    for (int t = 0; t < threads_amount; ++t) {
+        threads.push_back(thread([&, t]() {
+            for (int i = 0; i < calls_amount; ++i) {
+                Request square("square");
+                square.Emplace<Value32S>("number", t * calls_amount + i);
+                Request *result = pool.Push(square, 5);
+                int32_t n = t * calls_amount + i;
+                if (!result || result->Get<Value32S>("square")->Get() != n * n)
+                    failed++;
+                delete result;
+            }
+        }));
+    }
+    for (auto& t : threads) t.join();
+    if (failed) {
+        cout << failed << " calls failed" << endl;
+        return 1;
+    }
+
+    // *************************************
+    // the dropped connections are refilled
+    // *************************************
+    vector<SafeConnection> conns = server.GetConnections();
+    conns[0]->Disconnect(true);
+    conns[1]->Disconnect(true);
+    conns.clear();
+    for (int i = 0; i < 5000 && ignored < 4; ++i) SleepMS(1);
+    for (int i = 0; i < 5000 && server.GetConnections().size() < pool_size; ++i) SleepMS(1);
+    for (int i = 0; i < 5000 && pool.GetConnectedAmount() < pool_size; ++i) SleepMS(1);
+    if (ignored != 4 || pool.GetConnectedAmount() != pool_size ||
+        server.GetConnections().size() != pool_size)
+    {
+        cout << "The pool isn't refilled" << endl;
+        return 1;
+    }
+
+    // ****
+    // stop
+    // ****
+    pool.Stop();
+    if (pool.IsStarted() || pool.GetConnectedAmount() != 0 || ignored != 8 ||
+        pool.Push(Request("square"), 5))
+    {
+        cout << "The pool isn't stopped" << endl;
+        return 1;
+    }
+    for (int i = 0; i < 5000 && server.GetConnections().size(); ++i) SleepMS(1);
+    if (server.GetConnections().size()) {
+        cout << "The server connections aren't closed" << endl;
+        return 1;
+    }
+
+    // nobody listens
+    if (pool.StartTcp("127.0.0.1", closed_port, 5) || pool.IsStarted()) {
+        cout << "Started without a server" << endl;
+        return 1;
+    }
+
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
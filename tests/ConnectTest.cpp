@@ -0,0 +1,145 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients connected at once.
+const int clients_amount = 500;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkConnectTest.sock";
+// The port to use.
+const uint16_t port = 23063;
+// The port nobody listens on.
+const uint16_t closed_port = 23064;
+
+// Get the amount of threads of the process.
+int GetThreadsAmount() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) return stoi(line.substr(8));
+    }
+    return -1;
+}
+
+int main() {
+    Reactor server_reactor(2);
+    Reactor client_reactor(2);
+
+    Server server;
+    server.SetReactor(&server_reactor);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+    Server tcp_server;
+    tcp_server.SetReactor(&server_reactor);
+    if (!tcp_server.StartTcp("127.0.0.1", port)) {
+        cout << "Failed to start the TCP server" << endl;
+        return 1;
+    }
+
+    // ***************
+    // async & futures
+    // ***************
+    {
+        Client client;
+        client.SetReactor(&client_reactor);
+        future<bool> connected = client.ConnectUnixFuture(socket_path, 5);
+        if (!connected.get() || !client.IsConnected() || client.IsConnecting()) {
+            cout << "ConnectUnixFuture() failed" << endl;
+            return 1;
+        }
+        // busy
+        if (client.ConnectUnixAsync(socket_path, 5, ConnectCallback())) {
+            cout << "Connected twice" << endl;
+            return 1;
+        }
+        client.Disconnect(true, true);
+
+        // refused, the callback is called once
+        atomic<int> calls(0), failures(0);
+        bool is_started = client.ConnectTcpAsync(
+            "127.0.0.1",
+            closed_port,
+            5,
+            [&](Client *c, bool is_connected) {
+                calls++;
+                if (!is_connected && c->IsConnecting()) failures++;
+            });
+        for (int i = 0; i < 5000 && client.IsConnecting(); ++i) SleepMS(1);
+        if (!is_started || calls != 1 || failures != 1 || client.IsConnected()) {
+            cout << "The refused connection wasn't reported" << endl;
+            return 1;
+        }
+
+        // invalid addresses
+        if (client.ConnectTcpAsync("not an address", port, 5, ConnectCallback()) ||
+            client.ConnectUnix(string(200, 'x'), 5))
+        {
+            cout << "Invalid address accepted" << endl;
+            return 1;
+        }
+
+        // reconnects after a failure
+        if (!client.ConnectTcp("127.0.0.1", port, 5)) {
+            cout << "ConnectTcp() failed" << endl;
+            return 1;
+        }
+        client.Disconnect(true, true);
+    }
+
+    // **********************************************
+    // many at once, no thread per connection attempt
+    // **********************************************
+    vector<Client*> clients;
+    for (int i = 0; i < clients_amount; ++i) {
+        clients.push_back(new Client());
+        clients.back()->SetReactor(&client_reactor);
+    }
+    int threads_before = GetThreadsAmount();
+    uint64_t start = NowMS();
+    uint32_t connected = Client::ConnectUnixMany(clients, socket_path, 10);
+    uint64_t unix_ms = NowMS() - start;
+    int threads_after = GetThreadsAmount();
+    for (int i = 0; i < 1000 && server.GetConnections().size() < clients_amount; ++i) SleepMS(1);
+    if (connected != clients_amount || threads_after != threads_before ||
+        server.GetConnections().size() != clients_amount)
+    {
+        cout << "Connected " << connected << ", threads: "
+             << threads_before << " -> " << threads_after << endl;
+        return 1;
+    }
+    for (auto c : clients) c->Disconnect(true, true);
+
+    start = NowMS();
+    connected = Client::ConnectTcpMany(clients, "127.0.0.1", port, 10);
+    uint64_t tcp_ms = NowMS() - start;
+    if (connected != clients_amount) {
+        cout << "Connected " << connected << " over TCP" << endl;
+        return 1;
+    }
+    cout << clients_amount << " clients connected in " << unix_ms
+         << " ms (UNIX), " << tcp_ms << " ms (TCP)" << endl;
+
+    // destroyed while connecting
+    for (auto c : clients) c->Disconnect(true, true);
+    for (auto c : clients) c->ConnectTcpAsync("127.0.0.1", port, 10, ConnectCallback());
+    for (auto c : clients) delete c;
+
+    server.Stop(-1);
+    tcp_server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Coroutine.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of sums requested.
+const int sums_amount = 100;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkCoroutineTest.sock";
+
+// Ask the remote side to square the number.
+Request Square(int32_t number) {
+    Request square("square");
+    square.Emplace<Value32S>("number", number);
+    return square;
+}
+
+// Client: respond with the squared number.
+void HandlerSquare(Connection *c, Request *r) {
+    Request result("result");
+    result.SetId(r->GetId());
+    int32_t number = r->Get<Value32S>("number")->Get();
+    result.Emplace<Value32S>("number", number * number);
+    c->Push(result, 0, false);
+
+    delete r;
+}
+
+// Server: calls the client back twice to sum the squares.
+Task HandlerSumOfSquares(Connection *c, Request *r) {
+    uint32_t id = r->GetId();
+    int32_t a = r->Get<Value32S>("a")->Get();
+    int32_t b = r->Get<Value32S>("b")->Get();
+    delete r;
+
+    // The loop thread isn't blocked meanwhile.
+    Request *square_a = co_await Call(c, Square(a), 5);
+    if (!square_a) co_return;
+    // The awaiter keeps its own copy of the temporary Request.
+    auto call_b = Call(c, Square(b), 5);
+    Request *square_b = co_await call_b;
+    if (!square_b) {
+        delete square_a;
+        co_return;
+    }
+
+    Request result("result");
+    result.SetId(id);
+    result.Emplace<Value32S>(
+        "number",
+        square_a->Get<Value32S>("number")->Get() +
+        square_b->Get<Value32S>("number")->Get());
+    c->Push(result, 0, false);
+
+    delete square_a;
+    delete square_b;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("sum_of_squares", CoHandler<HandlerSumOfSquares>);
+    c->Push(Request("hello"));
+}
+
+// Client: wait for the hello and request the sums one by one.
+Task ClientFlow(Client *c, atomic<int> *status) {
+    Request *hello = co_await Next(c);
+    if (!hello) {
+        *status = -1;
+        co_return;
+    }
+    delete hello;
+
+    for (int32_t i = 0; i < sums_amount; ++i) {
+        Request sum("sum_of_squares");
+        sum.Emplace<Value32S>("a", i);
+        sum.Emplace<Value32S>("b", i + 1);
+
+        Request *result = co_await Call(c, sum, 5);
+        if (!result ||
+            result->Get<Value32S>("number")->Get() != i * i + (i + 1) * (i + 1))
+        {
+            delete result;
+            *status = -1;
+            co_return;
+        }
+        delete result;
+    }
+
+    // Nothing more will come.
+    c->Disconnect(true);
+    Request *last = co_await Next(c);
+    *status = last ? -1 : 1;
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    client.SetHandlerNamed("square", HandlerSquare);
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+
+    // Runs until the first suspension, then in the event loop thread.
+    atomic<int> status(0);
+    ClientFlow(&client, &status);
+
+    for (int i = 0; i < 10000 && !status; ++i) SleepMS(1);
+    if (status != 1) {
+        cout << "The coroutines failed" << endl;
+        return 1;
+    }
+
+    client.WaitForStop(5);
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+#include "../HandlerPool.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients to connect.
+const int clients_amount = 4;
+// Amount of requests sent by each client at once.
+const int burst_size = 20;
+// How long each request is handled.
+const int work_ms = 10;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkHandlerPoolTest.sock";
+
+void HandlerWork(Connection *c, Request *r) {
+    // A slow handler, the later requests must wait for it.
+    SleepMS(work_ms);
+
+    // The loop looks the handlers up meanwhile.
+    c->SetHandlerNamed("work", HandlerWork);
+
+    Request done("done");
+    done.Emplace<Value32S>("number", r->Get<Value32S>("number")->Get());
+    c->Push(done);
+
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("work", HandlerWork);
+    c->Push(Request("hello"));
+}
+
+int main() {
+    // A single loop: without the pool all the handlers would
+    // run in it one after another.
+    Reactor server_reactor(1);
+    HandlerPool pool(clients_amount);
+
+    Server server;
+    server.SetReactor(&server_reactor);
+    server.SetHandlerPool(&pool);
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    // Connect the clients and wait for the handlers to be set.
+    vector<Client*> clients;
+    for (int i = 0; i < clients_amount; ++i) {
+        Client *c = new Client();
+        if (!c->ConnectUnix(socket_path, 5)) {
+            cout << "Failed to connect client #" << i << endl;
+            return 1;
+        }
+        Request *hello = PullFor(c, 5000);
+        if (!hello) {
+            cout << "No hello for client #" << i << endl;
+            return 1;
+        }
+        delete hello;
+        clients.push_back(c);
+    }
+
+    // Everyone sends a burst at once.
+    long started = NowMS();
+    for (auto c : clients) {
+        for (int i = 0; i < burst_size; ++i) {
+            Request work("work");
+            work.Emplace<Value32S>("number", i);
+            c->Push(work);
+        }
+    }
+
+    // The responses of each connection come in order.
+    for (int c = 0; c < clients_amount; ++c) {
+        for (int i = 0; i < burst_size; ++i) {
+            Request *r = PullFor(clients[c], 5000);
+            if (!r || r->Get<Value32S>("number")->Get() != i) {
+                cout << "Wrong order for client #" << c << endl;
+                return 1;
+            }
+            delete r;
+        }
+    }
+    long elapsed = NowMS() - started;
+
+    // The connections are handled in parallel.
+    long serial = clients_amount * burst_size * work_ms;
+    cout << "Handled in " << elapsed << " ms (serial: " << serial << " ms)" << endl;
+    if (elapsed >= serial * 3 / 4) {
+        cout << "The handlers didn't run in parallel" << endl;
+        return 1;
+    }
+
+    for (auto c : clients) delete c;
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
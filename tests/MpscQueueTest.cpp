@@ -0,0 +1,147 @@
+#include "../MpscQueue.hpp"
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of producer threads.
+const int producers_amount = 8;
+// Amount of values pushed by each producer to the queue.
+const int values_amount = 100000;
+// Amount of requests pushed by each producer to the connection.
+const int requests_amount = 500;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkMpscQueueTest.sock";
+
+// The IDs of the requests received by the server.
+mutex mutex_ids;
+set<uint32_t> ids;
+// The next number expected from each producer.
+int expected[producers_amount];
+atomic<int> received(0), misordered(0);
+
+void HandlerNumber(Connection *c, Request *r) {
+    int producer = r->Get<Value32S>("producer")->Get();
+    int number = r->Get<Value32S>("number")->Get();
+    if (number != expected[producer]++) misordered++;
+
+    mutex_ids.lock();
+    ids.insert(r->GetId());
+    mutex_ids.unlock();
+    received++;
+
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("number", HandlerNumber);
+    c->Push(Request("hello"));
+}
+
+int main() {
+    // ***************
+    // the queue alone
+    // ***************
+    {
+        MpscQueue<uint64_t> queue;
+        vector<thread> producers;
+        for (int p = 0; p < producers_amount; ++p) {
+            producers.emplace_back([&queue, p]() {
+                for (uint64_t i = 1; i <= values_amount; ++i)
+                    queue.Push((uint64_t(p) << 32) | i);
+            });
+        }
+
+        // the values of each producer come in order
+        uint64_t last[producers_amount] = { 0 };
+        int popped = 0;
+        while (popped < producers_amount * values_amount) {
+            uint64_t value;
+            if (!queue.Pop(value)) continue;
+            int p = value >> 32;
+            if ((value & 0xFFFFFFFF) != last[p] + 1) {
+                cout << "The queue reordered the values" << endl;
+                return 1;
+            }
+            last[p]++;
+            popped++;
+        }
+        for (auto& t : producers) t.join();
+
+        uint64_t value;
+        if (!queue.IsEmpty() || queue.Pop(value)) {
+            cout << "The queue isn't empty" << endl;
+            return 1;
+        }
+    }
+
+    // ***************************
+    // the connection's send queue
+    // ***************************
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    // The handlers are set once it's received.
+    Request *hello = client.Pull(5000);
+    if (!hello) {
+        cout << "No hello" << endl;
+        return 1;
+    }
+    delete hello;
+
+    // Everyone pushes at once.
+    vector<thread> producers;
+    for (int p = 0; p < producers_amount; ++p) {
+        producers.emplace_back([&client, p]() {
+            for (int i = 0; i < requests_amount; ++i) {
+                Request number("number");
+                number.Emplace<Value32S>("producer", p);
+                number.Emplace<Value32S>("number", i);
+                client.Push(number);
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+
+    const int total = producers_amount * requests_amount;
+    for (int i = 0; i < 5000 && received < total; ++i) SleepMS(1);
+    if (received != total || misordered) {
+        cout << "Received: " << received << ", misordered: " << misordered << endl;
+        return 1;
+    }
+
+    // The IDs are unique and odd (the client's half).
+    bool is_odd = true;
+    for (uint32_t id : ids) is_odd = is_odd && id % 2;
+    if (ids.size() != total || !is_odd) {
+        cout << "The request IDs are broken" << endl;
+        return 1;
+    }
+
+    client.Disconnect(true, true);
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
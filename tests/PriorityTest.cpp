@@ -0,0 +1,93 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/ValueStr.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of bulk requests queued before the control one.
+const int bulk_amount = 2000;
+// The port to use.
+// remark:  TCP, so a part of the gathered frames waits for the room
+const uint16_t port = 23067;
+
+// The server side of the connection.
+atomic<Connection*> server_conn(0);
+// Amount of the received requests.
+atomic<int> received(0);
+// The index the control request is received at.
+atomic<int> control_index(-1);
+
+void HandlerDefault(Connection *conn, Request *r) {
+    if (r->GetName() == "control") control_index = received.load();
+    received++;
+    delete r;
+}
+
+void ConnectedHandler(Server *server, Connection *conn) {
+    conn->SetHandlerDefault(HandlerDefault);
+    // don't read until everything is queued
+    conn->SetReceiving(false);
+    server_conn = conn;
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(ConnectedHandler);
+    if (!server.StartTcp("127.0.0.1", port)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    if (!client.ConnectTcp("127.0.0.1", port, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    for (int i = 0; i < 500 && !server_conn; i++) SleepMS(10);
+    if (!server_conn) {
+        cout << "Not accepted" << endl;
+        return 1;
+    }
+
+    // **************************
+    // control overtakes the bulk
+    // **************************
+    Request bulk("bulk");
+    bulk.Emplace<ValueStr>("data", string(4000, 'x'));
+    for (int i = 0; i < bulk_amount; i++)
+        client.Push(bulk, 0, true, SendPriorityBulk);
+    // the kernel buffers are filled by now
+    SleepMS(200);
+    uint32_t bulk_size = bulk.GetSize();
+    uint32_t in_kernel =
+        (bulk_amount * bulk_size - client.GetUnsentBytes() + bulk_size - 1) / bulk_size;
+    client.Push(Request("control"), 0, true, SendPriorityControl);
+
+    // remark:  only the bulk already in the kernel (the last one
+    //          partially) is ahead of it, not the gathered one
+    server_conn.load()->SetReceiving(true);
+    for (int i = 0; i < 1000 && received <= bulk_amount; i++) SleepMS(10);
+    if (received != bulk_amount + 1) {
+        cout << "Received " << received << " requests" << endl;
+        return 1;
+    }
+    if (control_index < 0 || control_index > (int)in_kernel) {
+        cout << "The control request is received at " << control_index
+             << ", " << in_kernel << " bulk ones were in the kernel" << endl;
+        return 1;
+    }
+
+    client.Disconnect(true, true);
+    server.Stop();
+    server.WaitForStop();
+
+    cout << "Success" << endl;
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of items in a burst.
+const int burst_size = 1000;
+// Amount of threads pulling at once.
+const int pullers_amount = 4;
+// The size of PullMany() batch.
+const int batch_size = 64;
+// The receive queue limit.
+const int queue_limit = 8;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkPullTest.sock";
+
+void HandlerBurst(Connection *c, Request *r) {
+    // Respond with the numbered items.
+    for (int i = 0; i < burst_size; ++i) {
+        Request item("item");
+        item.Emplace<Value32S>("number", i);
+        c->Push(item);
+    }
+
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("burst", HandlerBurst);
+    c->Push(Request("hello"));
+}
+
+int main(int argc, char **argv) {
+    // remark:  with io_uring every pause cancels the multishot receive
+    uint8_t backend =
+        argc > 1 && string(argv[1]) == "io_uring" ?
+        IoBackendIoUring : IoBackendEpoll;
+
+    Server server(backend);
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client(backend);
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    // The handlers are set once it's received.
+    Request *hello = client.Pull(5000);
+    if (!hello) {
+        cout << "No hello" << endl;
+        return 1;
+    }
+    delete hello;
+
+    // ****************
+    // batches in order
+    // ****************
+    client.Push(Request("burst"));
+    Request *batch[batch_size];
+    int pulled = 0;
+    while (pulled < burst_size) {
+        uint32_t amount = client.PullMany(batch, batch_size, 5000);
+        if (!amount) {
+            cout << "PullMany() timed out after " << pulled << " items" << endl;
+            return 1;
+        }
+        for (uint32_t i = 0; i < amount; ++i) {
+            if (batch[i]->Get<Value32S>("number")->Get() != pulled++) {
+                cout << "PullMany() reordered the items" << endl;
+                return 1;
+            }
+            delete batch[i];
+        }
+    }
+
+    // *********************
+    // limited receive queue
+    // *********************
+    client.SetRecvQueueLimit(queue_limit);
+    client.Push(Request("burst"));
+    // the rest waits in the kernel
+    SleepMS(200);
+    // remark:  the rest of the chunk read at once is held back
+    uint32_t queued = client.PullMany(batch, batch_size, 5000);
+    if (queued != queue_limit) {
+        cout << "The receive queue isn't limited: " << queued << " items" << endl;
+        return 1;
+    }
+    pulled = 0;
+    for (uint32_t i = 0; i < queued; ++i) {
+        pulled += batch[i]->Get<Value32S>("number")->Get() == pulled;
+        delete batch[i];
+    }
+    // the reading is resumed
+    while (pulled < burst_size) {
+        Request *r = client.Pull(5000);
+        if (!r) {
+            cout << "Pull() timed out after " << pulled << " items" << endl;
+            return 1;
+        }
+        if (r->Get<Value32S>("number")->Get() != pulled++) {
+            cout << "Pull() reordered the items" << endl;
+            return 1;
+        }
+        delete r;
+    }
+    client.SetRecvQueueLimit(0);
+
+    // *****************
+    // many pullers wait
+    // *****************
+    vector<atomic<int>> seen(burst_size);
+    for (auto& s : seen) s = 0;
+    atomic<int> total(0), woken(0);
+    vector<thread> pullers;
+    for (int t = 0; t < pullers_amount; ++t) {
+        pullers.emplace_back([&]() {
+            // until the connection is lost
+            while (Request *r = client.Pull(-1)) {
+                seen[r->Get<Value32S>("number")->Get()]++;
+                total++;
+                delete r;
+            }
+            woken++;
+        });
+    }
+    // everyone is waiting by now
+    SleepMS(100);
+    client.Push(Request("burst"));
+    for (int i = 0; i < 5000 && total < burst_size; ++i) SleepMS(1);
+
+    // the disconnection wakes everyone up
+    client.Disconnect(true, true);
+    for (auto& t : pullers) t.join();
+
+    bool is_once = true;
+    for (auto& s : seen) is_once = is_once && s == 1;
+    if (total != burst_size || !is_once || woken != pullers_amount) {
+        cout << "Pulled: " << total << ", woken: " << woken << endl;
+        return 1;
+    }
+
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../Reactor.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <dirent.h>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients to connect.
+const int clients_amount = 64;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkReactorTest.sock";
+
+// Count the threads of this process.
+int CountThreads() {
+    int result = 0;
+    DIR *d = opendir("/proc/self/task");
+    if (!d) return -1;
+    while (dirent *e = readdir(d)) {
+        if (e->d_name[0] != '.') ++result;
+    }
+    closedir(d);
+    return result;
+}
+
+void HandlerPing(Connection *c, Request *r) {
+    // Respond with the incremented number.
+    Request pong("pong");
+    pong.Emplace<Value32S>("number", r->Get<Value32S>("number")->Get() + 1);
+    c->Push(pong);
+
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    // Setup the handler and let the client know it's set.
+    c->SetHandlerNamed("ping", HandlerPing);
+    c->Push(Request("hello"));
+}
+
+void HandlerDisconnected(Server *s, Connection *c) {
+
+}
+
+int main() {
+    // Two loops for all the server connections, two for all the clients.
+    Reactor server_reactor(2);
+    Reactor client_reactor(2);
+
+    // Start the server.
+    Server server;
+    server.SetReactor(&server_reactor);
+    server.SetConnectedHandler(HandlerConnected);
+    server.SetDisconnectedHandler(HandlerDisconnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    // Connect the clients.
+    vector<Client*> clients;
+    for (int i = 0; i < clients_amount; ++i) {
+        Client *c = new Client();
+        c->SetReactor(&client_reactor);
+        if (!c->ConnectUnix(socket_path, 5)) {
+            cout << "Failed to connect client #" << i << endl;
+            return 1;
+        }
+        clients.push_back(c);
+    }
+
+    // Wait for greetings and send the pings.
+    for (int i = 0; i < clients_amount; ++i) {
+        Request *hello = PullFor(clients[i], 5000);
+        if (!hello || hello->GetName() != "hello") {
+            cout << "No greeting for client #" << i << endl;
+            return 1;
+        }
+        delete hello;
+
+        Request ping("ping");
+        ping.Emplace<Value32S>("number", i);
+        clients[i]->Push(ping);
+    }
+
+    // Check the responses.
+    for (int i = 0; i < clients_amount; ++i) {
+        Request *pong = PullFor(clients[i], 5000);
+        if (!pong || pong->GetName() != "pong" ||
+            pong->Get<Value32S>("number")->Get() != i + 1)
+        {
+            cout << "Invalid response for client #" << i << endl;
+            return 1;
+        }
+        delete pong;
+    }
+
+    // The thread count must not depend on the connection count.
+    int threads = CountThreads();
+    cout << clients_amount * 2 << " connections served by "
+         << threads << " threads" << endl;
+    if (threads >= clients_amount) {
+        cout << "Too many threads" << endl;
+        return 1;
+    }
+
+    // Cleanup.
+    for (auto c : clients) delete c;
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
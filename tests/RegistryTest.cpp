@@ -0,0 +1,123 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients connected.
+const int clients_amount = 64;
+// Amount of threads looking up at once.
+const int readers_amount = 4;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkRegistryTest.sock";
+
+atomic<int> accepted(0);
+
+void HandlerConnected(Server *s, Connection *c) {
+    // tagged before it's registered
+    s->SetTag(c, "client-" + to_string(accepted++));
+    c->Push(Request("hello"));
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client clients[clients_amount];
+    for (auto& client : clients) {
+        if (!client.ConnectUnix(socket_path, 5)) {
+            cout << "Failed to connect" << endl;
+            return 1;
+        }
+        Request *hello = client.Pull(5000);
+        if (!hello) {
+            cout << "No hello" << endl;
+            return 1;
+        }
+        delete hello;
+    }
+
+    // *******************
+    // lookups by ID & tag
+    // *******************
+    vector<SafeConnection> all = server.GetConnections();
+    if (all.size() != clients_amount) {
+        cout << "The snapshot has " << all.size() << " connections" << endl;
+        return 1;
+    }
+    for (auto& c : all) {
+        SafeConnection by_id = server.GetConnection(c->id);
+        SafeConnection by_tag = server.GetConnection(c->tag);
+        if (by_id.Get() != c.Get() || by_tag.Get() != c.Get()) {
+            cout << "Lookup of " << c->tag << " failed" << endl;
+            return 1;
+        }
+    }
+    if (server.GetConnection("client-" + to_string(clients_amount))) {
+        cout << "Found the unknown tag" << endl;
+        return 1;
+    }
+
+    // retagging moves the index entry
+    SafeConnection first = server.GetConnection("client-0");
+    server.SetTag(first.Get(), "renamed");
+    if (server.GetConnection("client-0") ||
+        server.GetConnection("renamed").Get() != first.Get())
+    {
+        cout << "Retagging failed" << endl;
+        return 1;
+    }
+    first.Reset();
+    all.clear();
+
+    // ***************************************
+    // lookups while the clients are going away
+    // ***************************************
+    atomic<bool> to_stop(false);
+    atomic<int> found(0);
+    vector<thread> readers;
+    for (int t = 0; t < readers_amount; ++t) {
+        readers.emplace_back([&]() {
+            while (!to_stop) {
+                for (int i = 1; i < clients_amount; ++i) {
+                    SafeConnection c = server.GetConnection("client-" + to_string(i));
+                    // held, so it's safe to touch
+                    if (c && c->GetRefs()) found++;
+                }
+                server.ForEachConnection([&](SafeConnection& c) { c->GetRefs(); });
+            }
+        });
+    }
+    SleepMS(20);
+    for (int i = 0; i < clients_amount; i += 2) clients[i].Disconnect(true, true);
+    SleepMS(100);
+    to_stop = true;
+    for (auto& t : readers) t.join();
+
+    int left = 0;
+    server.ForEachConnection([&](SafeConnection& c) { left++; });
+    if (!found || left != clients_amount / 2 ||
+        server.GetConnections().size() != clients_amount / 2)
+    {
+        cout << "Found: " << found << ", left: " << left << endl;
+        return 1;
+    }
+
+    for (auto& client : clients) client.Disconnect(true, true);
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <atomic>
+#include <utility>
+#include <iostream>
+#include <new>
+#include <cstdlib>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients connected.
+const int clients_amount = 8;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkSafeConnectionTest.sock";
+
+// Amount of heap allocations in the whole process.
+atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void *p = malloc(size)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->Push(Request("hello"));
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client clients[clients_amount];
+    for (auto& client : clients) {
+        if (!client.ConnectUnix(socket_path, 5)) {
+            cout << "Failed to connect" << endl;
+            return 1;
+        }
+        Request *hello = client.Pull(5000);
+        if (!hello) {
+            cout << "No hello" << endl;
+            return 1;
+        }
+        delete hello;
+    }
+
+    // ****************
+    // copying & moving
+    // ****************
+    uint32_t last_id = 0;
+    server.ForEachConnection([&](SafeConnection& c) { last_id = c->id; });
+    SafeConnection none = server.GetConnection(uint32_t(-1));
+    SafeConnection c = server.GetConnection(last_id);
+    if (none || !c || c->GetRefs() != 1) {
+        cout << "GetConnection() failed" << endl;
+        return 1;
+    }
+    {
+        SafeConnection copy = c;
+        SafeConnection assigned;
+        assigned = copy;
+        if (c->GetRefs() != 3 || &*assigned != &c()) {
+            cout << "Copying doesn't add a reference" << endl;
+            return 1;
+        }
+        SafeConnection moved = move(copy);
+        if (copy || c->GetRefs() != 3) {
+            cout << "Moving changes the references" << endl;
+            return 1;
+        }
+        assigned = move(moved);
+        assigned = assigned;
+        if (c->GetRefs() != 2) {
+            cout << "Assignment leaked a reference" << endl;
+            return 1;
+        }
+    }
+    if (c->GetRefs() != 1) {
+        cout << "The copies weren't released" << endl;
+        return 1;
+    }
+    c.Reset();
+    if (c) {
+        cout << "Reset() didn't empty the handle" << endl;
+        return 1;
+    }
+
+    // ******************************
+    // fan-out doesn't touch the heap
+    // ******************************
+    int visited = 0;
+    uint64_t before = allocations;
+    server.ForEachConnection([&](SafeConnection& c) {
+        if (c->GetRefs()) visited++;
+    });
+    uint64_t after = allocations;
+    if (visited != clients_amount || after != before) {
+        cout << "Visited " << visited << ", allocated " << after - before << endl;
+        return 1;
+    }
+
+    // the handle keeps the connection until released
+    c = server.GetConnection(last_id);
+    c->Disconnect(true);
+    SleepMS(100);
+    if (c->WaitForStop(0)) {
+        cout << "The held connection was finalized" << endl;
+        return 1;
+    }
+    c.Reset();
+
+    for (auto& client : clients) client.Disconnect(true, true);
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of requests sent before the graceful disconnection.
+const int requests_amount = 1000;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkStateTest.sock";
+
+atomic<int> received(0);
+
+void HandlerNumber(Connection *c, Request *r) {
+    received++;
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("number", HandlerNumber);
+    c->Push(Request("hello"));
+}
+
+// Connect and wait for the handlers to be set.
+bool Connect(Client& client) {
+    if (!client.ConnectUnix(socket_path, 5)) return false;
+    Request *hello = client.Pull(5000);
+    delete hello;
+    return hello;
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    if (client.GetState() != ConnectionStateStopped || !Connect(client) ||
+        client.GetState() != ConnectionStateConnected)
+    {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+
+    // **********************************************
+    // graceful: everything queued is sent, then stop
+    // **********************************************
+    for (int i = 0; i < requests_amount; ++i) {
+        Request number("number");
+        number.Emplace<Value32S>("number", i);
+        client.Push(number);
+    }
+    client.Disconnect();
+    if (!client.WaitForStop(5)) {
+        cout << "The graceful disconnection failed" << endl;
+        return 1;
+    }
+    for (int i = 0; i < 5000 && received < requests_amount; ++i) SleepMS(1);
+    if (received != requests_amount || client.IsConnected() ||
+        client.GetType() != SocketTypeUndefined)
+    {
+        cout << "Received " << received << " before the disconnection" << endl;
+        return 1;
+    }
+
+    // ... with nothing to send
+    if (!Connect(client)) {
+        cout << "Failed to reconnect" << endl;
+        return 1;
+    }
+    client.Disconnect();
+    if (!client.WaitForStop(5)) {
+        cout << "The idle connection didn't stop gracefully" << endl;
+        return 1;
+    }
+
+    // *************************************************
+    // forced: the referenced connection isn't finalized
+    // *************************************************
+    if (!Connect(client)) {
+        cout << "Failed to reconnect" << endl;
+        return 1;
+    }
+    client.IncreaseRefs();
+    client.Disconnect(true);
+    SleepMS(100);
+    if (client.WaitForStop(0) || client.GetState() != ConnectionStateStopping) {
+        cout << "The referenced connection was finalized" << endl;
+        return 1;
+    }
+    client.DecreaseRefs();
+    if (!client.WaitForStop(5) || client.GetRefs()) {
+        cout << "The released connection wasn't finalized" << endl;
+        return 1;
+    }
+
+    // ***************************************
+    // many threads pushing while disconnected
+    // ***************************************
+    if (!Connect(client)) {
+        cout << "Failed to reconnect" << endl;
+        return 1;
+    }
+    atomic<bool> to_stop(false);
+    vector<thread> pushers;
+    for (int t = 0; t < 4; ++t) {
+        pushers.emplace_back([&]() {
+            while (!to_stop) client.Push(Request("number"));
+        });
+    }
+    SleepMS(50);
+    client.Disconnect(true, true);
+    to_stop = true;
+    for (auto& t : pushers) t.join();
+    if (client.IsConnected() || client.GetRefs()) {
+        cout << "The forced disconnection failed" << endl;
+        return 1;
+    }
+
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/All.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of clients reading everything.
+const int readers_amount = 8;
+// Amount of clients not reading at all.
+const int stallers_amount = 2;
+// Amount of clients not reading and quitting during the stop.
+const int quitters_amount = 2;
+// Amount of items sent to each reader.
+const int items_amount = 100;
+// Amount of bulk requests sent to each staller.
+const int bulk_amount = 2000;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkStopTest.sock";
+
+// Amount of the handled requests.
+atomic<int> handled(0);
+
+void HandlerItems(Connection *c, Request *r) {
+    for (int i = 0; i < items_amount; ++i) {
+        Request item("item");
+        item.Emplace<Value32S>("number", i);
+        c->Push(item);
+    }
+    handled++;
+    delete r;
+}
+
+void HandlerBulk(Connection *c, Request *r) {
+    Request bulk("bulk");
+    bulk.Emplace<ValueStr>("data", string(4000, 'x'));
+    for (int i = 0; i < bulk_amount; ++i) c->Push(bulk);
+    handled++;
+    delete r;
+}
+
+void HandlerConnected(Server *s, Connection *c) {
+    c->SetHandlerNamed("items", HandlerItems);
+    c->SetHandlerNamed("bulk", HandlerBulk);
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(HandlerConnected);
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    vector<Client*> readers, stallers, quitters, all;
+    for (int i = 0; i < readers_amount; ++i) readers.push_back(new Client());
+    for (int i = 0; i < stallers_amount; ++i) stallers.push_back(new Client());
+    for (int i = 0; i < quitters_amount; ++i) quitters.push_back(new Client());
+    all.insert(all.end(), readers.begin(), readers.end());
+    all.insert(all.end(), stallers.begin(), stallers.end());
+    all.insert(all.end(), quitters.begin(), quitters.end());
+    if (Client::ConnectUnixMany(all, socket_path, 5) != all.size()) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+
+    // the stallers never read, so their send queues never drain
+    for (auto c : stallers) {
+        c->SetReceiving(false);
+        c->Push(Request("bulk"));
+    }
+    for (auto c : quitters) {
+        c->SetReceiving(false);
+        c->Push(Request("bulk"));
+    }
+    for (auto c : readers) c->Push(Request("items"));
+    for (int i = 0; i < 500 && handled < (int)all.size(); ++i) SleepMS(10);
+    if (handled != (int)all.size()) {
+        cout << "Handled " << handled << " requests" << endl;
+        return 1;
+    }
+
+    // **************************
+    // drained or cut off at once
+    // **************************
+    // the quitters close their ends with the data unsent
+    thread quit([&quitters]() {
+        SleepMS(200);
+        for (auto c : quitters) c->Disconnect(true, true);
+    });
+    uint64_t started = NowMS();
+    StopReport report = server.StopGracefully(1);
+    uint64_t elapsed = NowMS() - started;
+    quit.join();
+    if (report.drained != readers_amount ||
+        report.cut_off != stallers_amount ||
+        report.failed != quitters_amount)
+    {
+        cout << "Drained " << report.drained << ", cut off " << report.cut_off
+             << ", failed " << report.failed << endl;
+        return 1;
+    }
+    // one deadline for everyone
+    if (elapsed > 3000) {
+        cout << "Stopped in " << elapsed << " ms" << endl;
+        return 1;
+    }
+
+    // the readers got everything pushed before the stop
+    for (auto c : readers) {
+        for (int i = 0; i < items_amount; ++i) {
+            Request *r = c->Pull(5000);
+            if (!r || r->Get<Value32S>("number")->Get() != i) {
+                cout << "Lost the item " << i << endl;
+                return 1;
+            }
+            delete r;
+        }
+    }
+
+    // stopped already
+    report = server.StopGracefully(1);
+    if (report.drained || report.cut_off || report.failed) {
+        cout << "Stopped twice" << endl;
+        return 1;
+    }
+
+    for (auto c : all) {
+        c->Disconnect(true, true);
+        delete c;
+    }
+
+    cout << "Success" << endl;
+    return 0;
+}
@@ -0,0 +1,40 @@
+/*!
+    \file
+
+    This file defines the helpers shared by the tests.
+*/
+
+#ifndef __DOWOW_NETWORK__TEST_UTILS_H_
+#define __DOWOW_NETWORK__TEST_UTILS_H_
+
+#include <cstdint>
+
+#include <time.h>
+
+#include "../Connection.hpp"
+#include "../Request.hpp"
+
+//! Sleep for the amount of milliseconds.
+inline void SleepMS(long ms) {
+    timespec ts { ms / 1000, (ms % 1000) * 1000 * 1000 };
+    nanosleep(&ts, 0);
+}
+
+//! Get the monotonic time in milliseconds.
+inline uint64_t NowMS() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//! Pull with a timeout in milliseconds.
+inline DowowNetwork::Request* PullFor(DowowNetwork::Connection *c, int ms) {
+    for (int i = 0; i < ms; ++i) {
+        DowowNetwork::Request *r = c->Pull(0);
+        if (r) return r;
+        SleepMS(1);
+    }
+    return 0;
+}
+
+#endif
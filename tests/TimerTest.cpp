@@ -0,0 +1,121 @@
+#include "../EventLoop.hpp"
+#include "../Utils.hpp"
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// Amount of timers started at once.
+const int timers_amount = 1000;
+// The allowed lateness of a timer, in milliseconds.
+// remark:  generous, a loaded machine may not run the loop thread
+//          for a while, the wheel only must not lose the timers.
+const uint64_t lateness_limit = 1000;
+// The socket to use.
+const string socket_path = "/tmp/DowowNetworkTimerTest.sock";
+
+// The moments the timers were fired at, 0 if not fired.
+atomic<uint64_t> fired_at[timers_amount];
+// How many times the timers were fired.
+atomic<int> fired_times[timers_amount];
+// Amount of the fired timers.
+atomic<int> fired_amount(0);
+
+void TimerFired(Timer *t) {
+    long index = reinterpret_cast<long>(t->owner);
+    if (!fired_times[index]++) fired_at[index] = Utils::GetMonotonicMS();
+    fired_amount++;
+}
+
+int main() {
+    EventLoop loop;
+
+    // the deadlines are spread over the wheel, some are beyond it
+    vector<Timer> timers(timers_amount);
+    vector<uint64_t> deadlines(timers_amount);
+    uint64_t now = Utils::GetMonotonicMS();
+    srand(42);
+    for (long i = 0; i < timers_amount; ++i) {
+        timers[i].callback = TimerFired;
+        timers[i].owner = reinterpret_cast<void*>(i);
+        fired_at[i] = 0;
+        fired_times[i] = 0;
+        deadlines[i] = now + 10 + rand() % (i % 10 ? 1000 : 5000);
+        loop.StartTimer(&timers[i], deadlines[i]);
+    }
+
+    // every 4th is postponed, every 10th (of the others) is stopped
+    int stopped_amount = 0;
+    for (long i = 0; i < timers_amount; ++i) {
+        if (i % 4 == 0) {
+            deadlines[i] += 300;
+            EventLoop::PostponeTimer(&timers[i], deadlines[i]);
+        } else if (i % 10 == 5) {
+            loop.StopTimer(&timers[i]);
+            deadlines[i] = 0;
+            stopped_amount++;
+        }
+    }
+
+    for (int i = 0; i < 7000 && fired_amount < timers_amount - stopped_amount; ++i)
+        SleepMS(1);
+    // the stopped ones might fire after all
+    SleepMS(100);
+
+    for (long i = 0; i < timers_amount; ++i) {
+        if (!deadlines[i]) {
+            if (fired_times[i]) {
+                cout << "The stopped timer " << i << " fired" << endl;
+                return 1;
+            }
+            continue;
+        }
+        if (fired_times[i] != 1) {
+            cout << "The timer " << i << " fired " << fired_times[i] << " times" << endl;
+            return 1;
+        }
+        // never early, and not lost
+        if (fired_at[i] < deadlines[i] ||
+            fired_at[i] > deadlines[i] + lateness_limit)
+        {
+            cout << "The timer " << i << " fired at " <<
+                (long)(fired_at[i] - deadlines[i]) << " ms" << endl;
+            return 1;
+        }
+    }
+
+    // 'their not alive' timer: a silent peer is disconnected
+    Server server;
+    if (!server.StartUnix(socket_path)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+    Client client;
+    if (!client.ConnectUnix(socket_path, 5)) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    client.SetTheirNaIntervalLimit(1);
+    uint64_t started = Utils::GetMonotonicMS();
+    client.WaitForStop(5);
+    uint64_t elapsed = Utils::GetMonotonicMS() - started;
+    if (client.IsConnected() || elapsed < 900 || elapsed > 1000 + lateness_limit) {
+        cout << "The silent peer wasn't disconnected in time: " <<
+            elapsed << " ms" << endl;
+        return 1;
+    }
+
+    server.Stop(-1);
+
+    cout << "PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "../Request.hpp"
+#include "../Server.hpp"
+#include "../Client.hpp"
+#include "../values/ValueStr.hpp"
+#include "TestUtils.hpp"
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace DowowNetwork;
+
+// The port to use.
+const uint16_t port = 23066;
+// The send queue watermarks.
+const uint32_t high_watermark = 64 * 1024;
+const uint32_t low_watermark = 16 * 1024;
+
+// The server side of the connection.
+atomic<Connection*> server_conn(0);
+// Amount of the watermark handlers called.
+atomic<int> high_calls(0);
+atomic<int> low_calls(0);
+
+void ConnectedHandler(Server *server, Connection *conn) {
+    // don't read, so the client's send queue grows
+    conn->SetReceiving(false);
+    server_conn = conn;
+}
+
+void HighHandler(Connection *conn, uint32_t unsent_bytes) {
+    high_calls++;
+}
+
+void LowHandler(Connection *conn, uint32_t unsent_bytes) {
+    low_calls++;
+}
+
+// Wait for the condition for up to 5 seconds.
+template<class F> bool WaitFor(F condition) {
+    for (int i = 0; i < 500 && !condition(); i++) SleepMS(10);
+    return condition();
+}
+
+// Push until the kernel buffers are full and the send queue
+// stays at the high watermark.
+bool Fill(Client &client, const Request &bulk) {
+    for (int i = 0; i < 1000; i++) {
+        while (client.GetUnsentBytes() < high_watermark) client.Push(bulk);
+        SleepMS(10);
+        if (client.GetUnsentBytes() < high_watermark) continue;
+        // not sent for a while
+        SleepMS(100);
+        if (client.GetUnsentBytes() >= high_watermark) return true;
+    }
+    return false;
+}
+
+int main() {
+    Server server;
+    server.SetConnectedHandler(ConnectedHandler);
+    if (!server.StartTcp("127.0.0.1", port)) {
+        cout << "Failed to start the server" << endl;
+        return 1;
+    }
+
+    Client client;
+    client.SetSendWatermarks(high_watermark, low_watermark);
+    client.SetHighWatermarkHandler(HighHandler);
+    client.SetLowWatermarkHandler(LowHandler);
+    if (!client.ConnectTcp("127.0.0.1", port, 5) || !WaitFor([]() { return server_conn != 0; })) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+
+    Request bulk("bulk");
+    bulk.Emplace<ValueStr>("data", string(4000, 'x'));
+
+    // ************
+    // fail on high
+    // ************
+    client.SetOverflowMode(OverflowModeFail);
+    // remark:  the kernel buffers are filled first
+    if (!Fill(client, bulk)) {
+        cout << "The kernel buffers aren't filled" << endl;
+        return 1;
+    }
+    client.Push(bulk);
+    if (!client.GetOverflowsAmount()) {
+        cout << "The send queue isn't bounded" << endl;
+        return 1;
+    }
+    // remark:  it might be drained a few times before the kernel is full
+    if (!high_calls || high_calls != low_calls + 1) {
+        cout << "The watermarks are reported " << high_calls << "/" << low_calls << " times" << endl;
+        return 1;
+    }
+    // refused
+    if (client.PushAsync(bulk, 5, [](Connection *c, Request *r) {})) {
+        cout << "PushAsync() isn't refused" << endl;
+        return 1;
+    }
+
+    // ************
+    // drop on high
+    // ************
+    client.SetOverflowMode(OverflowModeDrop);
+    {
+        uint64_t overflows = client.GetOverflowsAmount();
+        bool is_called = false;
+        bool is_pushed = client.PushAsync(bulk, 5, [&is_called](Connection *c, Request *r) {
+            is_called = !r;
+        });
+        if (!is_pushed || !is_called || client.GetOverflowsAmount() != overflows + 1) {
+            cout << "The request isn't dropped" << endl;
+            return 1;
+        }
+    }
+
+    // *************
+    // block on high
+    // *************
+    client.SetOverflowMode(OverflowModeBlock);
+    {
+        atomic<bool> is_pushed(false);
+        thread pusher([&client, &bulk, &is_pushed]() {
+            client.Push(bulk);
+            is_pushed = true;
+        });
+
+        // blocked while the server doesn't read
+        SleepMS(300);
+        if (is_pushed) {
+            cout << "Push() isn't blocked" << endl;
+            return 1;
+        }
+
+        // resumed once drained to the low watermark
+        server_conn.load()->SetReceiving(true);
+        if (!WaitFor([&is_pushed]() { return is_pushed.load(); })) {
+            cout << "Push() isn't resumed" << endl;
+            return 1;
+        }
+        pusher.join();
+    }
+    if (low_calls != high_calls) {
+        cout << "The drain isn't reported" << endl;
+        return 1;
+    }
+    if (!WaitFor([&client]() { return client.GetUnsentBytes() == 0; })) {
+        cout << "The send queue isn't drained" << endl;
+        return 1;
+    }
+
+    // ******************
+    // unblocked on close
+    // ******************
+    // remark:  a new connection, the windows of the old one are grown
+    client.Disconnect(true, true);
+    server_conn = 0;
+    if (!client.ConnectTcp("127.0.0.1", port, 5) || !WaitFor([]() { return server_conn != 0; })) {
+        cout << "Failed to reconnect" << endl;
+        return 1;
+    }
+    client.SetOverflowMode(OverflowModeFail);
+    if (!Fill(client, bulk)) {
+        cout << "The kernel buffers aren't filled" << endl;
+        return 1;
+    }
+    client.SetOverflowMode(OverflowModeBlock);
+    {
+        thread pusher([&client, &bulk]() { client.Push(bulk); });
+        SleepMS(100);
+        client.Disconnect(true, true);
+        pusher.join();
+    }
+
+    server.Stop();
+    server.WaitForStop();
+
+    cout << "Success" << endl;
+    return 0;
+}